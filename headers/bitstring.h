@@ -7,12 +7,19 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
-constexpr std::uint8_t BITS_PER_ELEMENT = CHAR_BIT;
+constexpr std::uint8_t BITS_PER_ELEMENT = 64;
 
+/**
+ * @brief a string of `len` bits stored least significant bit first in 64 bit
+ * words
+ * @details bit `i` is bit `i % 64` of word `i / 64`. The operators work a word
+ * at a time, bits at or past `len` are ignored when comparing and counting.
+ */
 class bitstring {
-  std::int8_t bits_left = BITS_PER_ELEMENT;
-  vec<std::uint8_t> bits = vec<std::uint8_t>(32);
+  /* bits past the end of `bits` read as 0 */
+  vec<std::uint64_t> bits;
 
 public:
   /**
@@ -22,16 +29,23 @@ public:
   */
   std::uint64_t len = 0;
 
-  bitstring();
+  /**
+   * @brief an empty bitstring
+   */
+  bitstring() = default;
 
   /* TODO: add a list initializer for uint8_t? */
 
+  /**
+   * @brief `len` bytes, the first byte holds bits 0 to 7
+   */
   bitstring(const std::uint8_t *bytes, const std::size_t len);
 
-  bitstring(const bitstring &bs);
+  bitstring(const bitstring &bs) = default;
+  bitstring(bitstring &&bs) = default;
 
   /**
-   * @brief make a bitstring out of a number
+   * @brief make a bitstring out of a number, 8 bits long
    */
   bitstring(const std::uint8_t n);
 
@@ -41,27 +55,40 @@ public:
    @brief gets the bits at index i
    @returns the bit at index i or 0 if out of bounds
   */
-  std::uint8_t get_bit(std::size_t i);
+  std::uint8_t get_bit(std::size_t i) const;
 
   /**
-   * @brief tries to set the bit i
+   * @brief tries to set the bit i, doesn't change `len`
    */
   void set_bit(std::size_t i);
 
   /**
-   * @brief tries to unset the bit i
+   * @brief tries to unset the bit i, doesn't change `len`
    */
   void unset_bit(std::size_t i);
 
   /**
    * @brief encodes a bitstring to the end of the current bitstring
+   * @details appends the first `to_encode.len` bits at bit `len`
    */
-  void encode(bitstring &to_encode);
+  void encode(const bitstring &to_encode);
 
   /**
-   * @brief reverses the entire bitstring using compiler specific stuff
+   * @brief reverses the order of the first `len` bits
    */
   bitstring &reverse();
+
+  /**
+   * @returns the amount of set bits in the first `len` bits
+   */
+  std::uint64_t popcount() const;
+
+  /**
+   * @returns the amount of unset bits before the first set bit counting down
+   * from bit `len - 1`, `len` if none is set
+   */
+  std::uint64_t leading_zeros() const;
+
   /**
    @brief reserves `n` bytes for the byte string
   */
@@ -71,7 +98,7 @@ public:
    * @brief this is basically just to make it "easier" to read the tree
    * correctly, should NOT be used for anything else
    */
-  void write_tree_path(std::ofstream &stream) const;
+  void write_tree_path(std::ostream &stream) const;
 
   /**
    * @brief does bitwise or on a bitstring
@@ -93,40 +120,207 @@ public:
   bitstring operator<<(const int i) const;
 
   /**
-   * @brief shifts a bitstring right
+   * @brief shifts a bitstring right, the lowest `i` bits are dropped and
+   * `len` shrinks by as much
    */
   bitstring &operator>>=(const int i);
   /**
-   * @brief shifts a bitstring left
+   * @brief shifts a bitstring left, `i` zeroes come in at the bottom and
+   * `len` grows by as much
    */
   bitstring &operator<<=(const int i);
   /**
-   * @brief does bitwise or on a bitstring
+   * @brief does bitwise or on a bitstring, the result is as long as the
+   * longer one
    */
   bitstring &operator|=(const bitstring &mask);
   /**
-   * @brief does bitwise and on a bitstring
+   * @brief does bitwise and on a bitstring, the result is as long as the
+   * longer one
    */
   bitstring &operator&=(const bitstring &mask);
   /**
-   * @brief compares bitstrings if they're equal
+   * @brief compares bitstrings if they're equal, i.e. they're as long and
+   * their first `len` bits match
    */
   bool operator==(const bitstring &bs) const;
   /**
    * @brief compares bitstrings if they're not equal
    */
   bool operator!=(const bitstring &bs) const;
-  bitstring &operator=(const bitstring &other);
+  bitstring &operator=(const bitstring &other) = default;
+  bitstring &operator=(bitstring &&other) = default;
 
   friend std::ostream &operator<<(std::ostream &os, const bitstring &value);
   friend std::ofstream &operator<<(std::ofstream &stream, const bitstring &bs);
+  friend class bitwriter;
 
 private:
   /**
-    this doesn't return a bitstring due to only
-    being used while encoding to save the bits from 1 element
-  */
-  std::uint64_t build_mask(std::size_t len) { return (1 << len) - 1; }
+   * @returns word `i`, 0 past the end of the storage
+   */
+  std::uint64_t word(const std::size_t i) const {
+    return i < bits.size() ? bits[i] : 0;
+  }
+
+  /**
+   * @returns byte `i` of the bits, the layout they're written in
+   */
+  std::uint8_t byte(const std::size_t i) const {
+    return word(i / sizeof(std::uint64_t)) >>
+           (i % sizeof(std::uint64_t) * CHAR_BIT);
+  }
+
+  /**
+   * @returns the amount of words `n` bits take
+   */
+  static std::size_t words(const std::uint64_t n) {
+    return (n + BITS_PER_ELEMENT - 1) / BITS_PER_ELEMENT;
+  }
+
+  /**
+   * @returns a mask of the bits of word `i` that are below `len`
+   */
+  std::uint64_t mask(const std::size_t i) const {
+    const std::uint64_t end = len - (std::uint64_t)i * BITS_PER_ELEMENT;
+    return end >= BITS_PER_ELEMENT ? ~std::uint64_t(0)
+                                   : (std::uint64_t(1) << end) - 1;
+  }
+};
+
+/**
+ * @brief streaming bit writer with a 64 bit accumulator
+ * @details codes are appended least significant bit first, which is the same
+ * bit order `bitstring::encode` produces, whole words are flushed to `out` as
+ * soon as the accumulator fills up so appending a code is O(1)
+ */
+class bitwriter {
+  std::vector<std::uint8_t> &out;
+  std::uint64_t buffer = 0;
+  /* amount of bits currently in the buffer, always < 64 */
+  std::uint8_t count = 0;
+  std::uint64_t total = 0;
+
+public:
+  explicit bitwriter(std::vector<std::uint8_t> &out) : out(out) {}
+
+  /**
+   * @brief appends the `len` lowest bits of `bits`
+   * @details `len` may be at most 32, the bits above `len` have to be zero
+   */
+  void write(const std::uint64_t bits, const std::uint8_t len) {
+    buffer |= bits << count;
+    total += len;
+    if (count + len < 64) {
+      count += len;
+      return;
+    }
+    flush_word();
+    /* the bits that didn't fit, a shift by 64 is undefined hence the check */
+    buffer = count ? bits >> (64 - count) : 0;
+    count = count + len - 64;
+  }
+
+  /**
+   * @brief appends the first `bs.len` bits of a bitstring
+   */
+  void write(const bitstring &bs);
+
+  /**
+   * @brief writes out whatever is left in the accumulator, padded with zeroes
+   * to a full byte
+   */
+  void finish();
+
+  /**
+   * @returns the amount of bits written so far
+   */
+  std::uint64_t bits_written() const { return total; }
+
+private:
+  void flush_word() {
+    const std::uint8_t *bytes = (const std::uint8_t *)&buffer;
+    out.insert(out.end(), bytes, bytes + sizeof(buffer));
+  }
+};
+
+/**
+ * @brief bit reader with a 64 bit buffer, the counterpart of `bitwriter`
+ * @details bits come out least significant bit first. A refill loads a whole
+ * unaligned little endian word and advances by the bytes that fit, after it
+ * at least 56 bits can be peeked. Only the last 7 bytes are read one at a
+ * time, past the end of the data the bits are zero.
+ */
+class bitreader {
+  const std::uint8_t *data;
+  std::size_t size;
+  /* the next byte that isn't completely in the buffer */
+  std::size_t position = 0;
+  std::uint64_t buffer = 0;
+  /* amount of valid bits in the buffer */
+  std::uint8_t count = 0;
+
+public:
+  /**
+   * @param skip bits to skip in the first byte, a stream can start in the
+   * middle of one
+   */
+  bitreader(const std::uint8_t *data, std::size_t size, std::uint8_t skip = 0)
+      : data(data), size(size) {
+    if (skip != 0 && size > 0) {
+      buffer = data[0] >> skip;
+      count = CHAR_BIT - skip;
+      position = 1;
+    }
+  }
+
+  /**
+   * @brief fills the buffer to at least 56 bits
+   */
+  void refill() {
+    if (position + sizeof(std::uint64_t) <= size) {
+      std::uint64_t word;
+      std::memcpy(&word, data + position, sizeof(word));
+      /* the bits of the last partial byte are loaded again next time */
+      buffer |= word << count;
+      position += (63 - count) >> 3;
+      count |= 56;
+      return;
+    }
+    while (count <= 56) {
+      const std::uint64_t byte = position < size ? data[position] : 0;
+      buffer |= byte << count;
+      position++;
+      count += CHAR_BIT;
+    }
+  }
+
+  /**
+   * @returns the next `n` bits without consuming them, `n` at most 56 and
+   * no more than what's in the buffer
+   */
+  std::uint64_t peek(const std::uint8_t n) const {
+    return buffer & ((std::uint64_t(1) << n) - 1);
+  }
+
+  /**
+   * @brief drops the next `n` bits, at most the bits in the buffer
+   */
+  void consume(const std::uint8_t n) {
+    buffer >>= n;
+    count -= n;
+  }
+
+  std::uint64_t read(const std::uint8_t n) {
+    const std::uint64_t bits = peek(n);
+    consume(n);
+    return bits;
+  }
+
+  /**
+   * @returns the bits currently in the buffer
+   */
+  std::uint8_t available() const { return count; }
 };
 
 #endif /* BITSTRING_H */
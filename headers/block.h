@@ -0,0 +1,151 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include "huffman.h"
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+/*
+  the block container, the input is split into `block_size` blocks which are
+  all compressed on their own so they can be done in parallel
+
+  struct {
+      char magic[4]; // "TIRA"
+      uint8_t version;
+      uint8_t flags;
+      uint32_t block_size;
+      uint64_t original_size;
+      uint32_t block_count;
+      uint64_t offsets[block_count]; // if CONTAINER_INDEXED, from file start
+      struct {
+          uint8_t method;
+          uint32_t raw_size;
+          uint32_t payload_size;
+          uint8_t payload[payload_size];
+      } blocks[block_count];
+  };
+
+  a streamed container doesn't know its size up front, original_size and
+  block_count are 0, there's no index and the blocks end with an `END_BLOCK`
+  which has no payload
+*/
+constexpr char CONTAINER_MAGIC[4] = {'T', 'I', 'R', 'A'};
+constexpr std::uint8_t CONTAINER_VERSION = 1;
+
+enum container_flags_t : std::uint8_t {
+  /* the header is followed by the offset of every block */
+  CONTAINER_INDEXED = 1,
+  /* the size is unknown and the blocks end with an `END_BLOCK` */
+  CONTAINER_STREAMED = 2,
+};
+
+/* the size of an input that is read from a pipe */
+constexpr std::uint64_t UNKNOWN_SIZE = UINT64_MAX;
+
+enum block_method_t : std::uint8_t {
+  /* code lengths, total bits and the huffman coded data */
+  HUFFMAN_BLOCK = 0,
+  /* the bytes as they are, for data that doesn't get smaller */
+  STORED_BLOCK = 1,
+  /* a single byte repeated raw_size times, the payload is that byte */
+  RLE_BLOCK = 2,
+  /* lz77 sequences split into streams, see lz77.h */
+  LZ77_BLOCK = 3,
+  /* code lengths and 4 interleaved huffman coded streams */
+  HUFFMAN4_BLOCK = 4,
+  /* order-1 huffman coded, the byte before picks the code table */
+  CONTEXT_BLOCK = 5,
+  /* marks the end of a streamed container */
+  END_BLOCK = 0xff,
+};
+
+struct container_header {
+  std::uint8_t version = CONTAINER_VERSION;
+  std::uint8_t flags = 0;
+  std::uint32_t block_size = 0;
+  std::uint64_t original_size = 0;
+  std::uint32_t block_count = 0;
+
+  static constexpr std::size_t SIZE = sizeof(CONTAINER_MAGIC) + 1 + 1 + 4 + 8 + 4;
+};
+
+struct block_header {
+  std::uint8_t method = HUFFMAN_BLOCK;
+  std::uint32_t raw_size = 0;
+  std::uint32_t payload_size = 0;
+
+  static constexpr std::size_t SIZE = 1 + 4 + 4;
+};
+
+/**
+ * @brief checks if the data starts with the container magic
+ */
+bool is_container(const std::uint8_t *data, std::size_t size);
+
+/**
+ * @brief appends the container header, without the index
+ */
+void write_container_header(const container_header &header,
+                            std::vector<std::uint8_t> &out);
+
+/**
+ * @brief reads a container header
+ * @return false if it's not a container or a version this doesn't know
+ */
+bool read_container_header(const std::uint8_t *data, std::size_t size,
+                           container_header &header);
+
+/**
+ * @brief reads the header in front of a block
+ * @return false if the header or the payload doesn't fit in `size`
+ */
+bool read_block_header(const std::uint8_t *data, std::size_t size,
+                       block_header &header);
+
+/**
+ * @brief checks the index of an indexed container against its data
+ * @details the block count has to fit the sizes, every block has to start
+ * where the one before it ends and have the size it should, and the last one
+ * has to end at the end of the data. Only the headers are read, so this is
+ * cheap enough to do before anything is allocated for the output.
+ * @param data the container, starting with its header
+ */
+bool check_container_index(const std::uint8_t *data, std::size_t size,
+                           const container_header &header);
+
+/**
+ * @brief the largest payload a valid block of `raw_size` bytes can have,
+ * this is the worst case with a sync point after every byte
+ */
+std::uint64_t max_payload_size(std::uint64_t raw_size);
+
+/**
+ * @brief appends the block that ends a streamed container
+ */
+void write_end_block(std::vector<std::uint8_t> &out);
+
+/**
+ * @brief compresses one block and appends it with its header to `out`
+ * @details the method is picked from the histogram before anything is coded,
+ * a block of one repeated byte is run length coded and a block the huffman
+ * codes wouldn't make smaller is stored as it is. With `options.context` the
+ * block is also coded with order-1 tables and with `options.lz77` it's also
+ * parsed with lz77, either is kept if it's the smallest.
+ * @param data the block, at most 4 GB
+ * @return false if the block couldn't be compressed
+ */
+bool encode_block(const std::uint8_t *data, std::size_t size,
+                  const huffman_options &options,
+                  std::vector<std::uint8_t> &out);
+
+/**
+ * @brief decompresses the payload of a block
+ * @param out has to fit `header.raw_size` bytes
+ * @param threads threads to decode the pieces between sync points on
+ * @return false if the payload is corrupt
+ */
+bool decode_block(const block_header &header, const std::uint8_t *payload,
+                  std::uint8_t *out, unsigned threads = 1);
+
+#endif /* BLOCK_H */
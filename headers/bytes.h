@@ -0,0 +1,27 @@
+#ifndef BYTES_H
+#define BYTES_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief appends the raw bytes of a value, the format is little endian since
+ * that's what everything this runs on is
+ */
+template <typename T>
+void append_value(std::vector<std::uint8_t> &out, const T value) {
+  const std::uint8_t *bytes = (const std::uint8_t *)&value;
+  out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+/**
+ * @brief reads a value written by `append_value`, doesn't have to be aligned
+ */
+template <typename T> T read_value(const std::uint8_t *data) {
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+#endif /* BYTES_H */
@@ -0,0 +1,71 @@
+#ifndef CODES_H
+#define CODES_H
+
+#include "path.h"
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief longest code `canonical_paths` can assign, the codes are counted in
+ * a 32 bit integer
+ */
+constexpr std::uint8_t CANONICAL_MAX_LEN = 32;
+
+/**
+ * @brief assigns canonical codes to the given code lengths
+ * @details codes of the same length are consecutive numbers in symbol order
+ * and shorter codes come first, so only the lengths need to be stored. The
+ * paths are written like the ones from the tree, the first step in bit 0.
+ * @param lengths code length of each byte, 0 if the byte isn't used
+ * @param paths where the paths are stored, indexed by byte
+ * @return false if the lengths are too long or don't fit in a prefix code
+ */
+bool canonical_paths(const std::uint8_t (&lengths)[UCHAR_MAX + 1],
+                     path_t (&paths)[UCHAR_MAX + 1]);
+
+/**
+ * @brief computes huffman code lengths without building a tree
+ * @details the used bytes are radix sorted by frequency, after which the
+ * lengths are computed in place in O(n) with the Moffat-Katajainen algorithm,
+ * which merges the sorted leaves and the internal nodes like the two queue
+ * method does
+ * @param frequencies how often each byte occurs
+ * @param lengths where the code length of each byte is stored, a lone byte
+ * gets a length of 1
+ * @return the longest code length
+ */
+std::uint8_t huffman_code_lengths(
+    const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+    std::uint8_t (&lengths)[UCHAR_MAX + 1]);
+
+/**
+ * @brief computes the optimal code lengths that are at most `max_len` long
+ * @details uses package-merge: every symbol is a coin worth its frequency in
+ * each of the `max_len` denominations, the cheapest 2n - 2 coins picked from
+ * the merged lists tell how long each code is
+ * @param frequencies how often each byte occurs
+ * @param max_len the longest allowed code, 2^max_len has to fit every symbol
+ * @param lengths where the code length of each byte is stored
+ * @return false if `max_len` is too short for the amount of symbols
+ */
+bool limit_code_lengths(const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                        std::uint8_t max_len,
+                        std::uint8_t (&lengths)[UCHAR_MAX + 1]);
+
+/**
+ * @brief writes the code lengths of every byte
+ * @details either as 256 raw lengths or as (length, run - 1) pairs, whichever
+ * is smaller, preceded by a byte telling which one it is
+ */
+void write_code_lengths(const std::uint8_t (&lengths)[UCHAR_MAX + 1],
+                        std::vector<std::uint8_t> &out);
+
+/**
+ * @brief reads the code lengths written by `write_code_lengths`
+ * @return the amount of bytes read, 0 if the data is malformed
+ */
+std::size_t read_code_lengths(const std::uint8_t *data, std::size_t size,
+                              std::uint8_t (&lengths)[UCHAR_MAX + 1]);
+
+#endif /* CODES_H */
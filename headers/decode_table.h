@@ -0,0 +1,92 @@
+#ifndef DECODE_TABLE_H
+#define DECODE_TABLE_H
+
+#include "bitstring.h"
+#include "path.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief one slot of the decoding table
+ * @details a primary slot either holds one or two whole symbols or links to a
+ * second level table for the codes longer than `decode_table::PRIMARY_BITS`
+ */
+struct decode_entry {
+  /* symbols[0] | symbols[1] << 8, or the offset of the second level table */
+  std::uint16_t value = 0;
+  /* bits consumed by the whole entry, or the index width of the second level */
+  std::uint8_t length = 0;
+  /* bits consumed by the first symbol, 0 if this links to a second level */
+  std::uint8_t first = 0;
+};
+
+/**
+ * @brief lookup table huffman decoder
+ * @details peeks `PRIMARY_BITS` bits at a time and emits up to two symbols
+ * per lookup, codes longer than that go through a second, smaller table
+ * indexed by the remaining bits
+ */
+class decode_table {
+  std::vector<decode_entry> entries;
+  /* shortest code, bounds how many symbols a bitstream can decode into */
+  std::uint8_t min_len = 0;
+
+public:
+  static constexpr std::uint8_t PRIMARY_BITS = 11;
+  /**
+   * @brief longest code the table accepts, keeps every lookup inside a
+   * single refill of the 64 bit bit buffer
+   */
+  static constexpr std::uint8_t MAX_CODE_LEN = 24;
+
+  /**
+   * @brief builds the table from the paths read from the header
+   * @param paths the paths, where bit 0 of a path is the first step
+   * @param count amount of paths
+   * @return false if the paths aren't a prefix code or are too long
+   */
+  bool build(const path_t *paths, std::size_t count);
+
+  /**
+   * @returns the most symbols `total_bits` bits can decode into
+   */
+  std::uint64_t max_symbols(std::uint64_t total_bits) const {
+    return min_len ? total_bits / min_len : 0;
+  }
+
+  /**
+   * @brief decodes the single symbol at the start of the reader, the reader
+   * has to have at least `MAX_CODE_LEN` bits
+   * @param length set to the length of the code, 0 if the bits aren't a code
+   */
+  std::uint8_t decode_one(const bitreader &reader,
+                          std::uint8_t &length) const {
+    decode_entry entry = entries[reader.peek(PRIMARY_BITS)];
+    if (entry.first == 0) {
+      if (entry.length == 0) {
+        length = 0;
+        return 0;
+      }
+      entry = entries[entry.value +
+                      (reader.peek(PRIMARY_BITS + entry.length) >> PRIMARY_BITS)];
+    }
+    length = entry.first;
+    return entry.value;
+  }
+
+  /**
+   * @brief decodes `total_bits` bits of data into `out`
+   * @param out_size how many bytes fit in `out`, `max_symbols(total_bits)`
+   * is always enough
+   * @param written amount of decoded bytes
+   * @param skip bits to skip in the first byte of `data`, not counted in
+   * `total_bits`
+   * @return false if the data doesn't decode or doesn't fit
+   */
+  bool decode(const std::uint8_t *data, std::size_t data_size,
+              std::uint64_t total_bits, std::uint8_t *out,
+              std::size_t out_size, std::size_t &written,
+              std::uint8_t skip = 0) const;
+};
+
+#endif /* DECODE_TABLE_H */
@@ -0,0 +1,44 @@
+#ifndef ENCODE_TABLE_H
+#define ENCODE_TABLE_H
+
+#include "bitstring.h"
+#include "path.h"
+#include <climits>
+#include <cstdint>
+
+/**
+ * @brief the code of every byte packed into a word, ready for `bitwriter`
+ * @details the bits are in the order they're written, bit 0 of the word is
+ * the first step of the path. Encoding a byte is then a table load and a
+ * shift into the accumulator, the bitstrings of the paths aren't touched in
+ * the encoding loop at all.
+ */
+struct encode_table {
+  /**
+   * @brief longest code a word holds, `bitwriter::write` takes at most this
+   */
+  static constexpr std::uint8_t MAX_CODE_LEN = 32;
+
+  std::uint32_t codes[UCHAR_MAX + 1] = {0};
+  std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+
+  encode_table() = default;
+
+  /**
+   * @param paths the paths of all 256 bytes, none longer than `MAX_CODE_LEN`
+   */
+  explicit encode_table(const path_t *paths) {
+    for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+      lengths[byte] = paths[byte].len;
+      for (std::uint8_t bit = 0; bit < paths[byte].len; bit++) {
+        codes[byte] |= (std::uint32_t)paths[byte].path.get_bit(bit) << bit;
+      }
+    }
+  }
+
+  void write(bitwriter &writer, std::uint8_t byte) const {
+    writer.write(codes[byte], lengths[byte]);
+  }
+};
+
+#endif /* ENCODE_TABLE_H */
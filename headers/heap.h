@@ -7,99 +7,127 @@
 #include <iostream>
 #include <algorithm>
 
-enum node_type_t {
+enum node_type_t : std::uint8_t {
     DATA, FILLER
 };
 constexpr const std::size_t NODES_SIZE = UCHAR_MAX * 2 + 1;
+/* the index of a child that doesn't exist */
+constexpr const std::uint16_t NO_NODE = UINT16_MAX;
 
 /**
  * @brief a node in the priority tree
+ * @details the children are indices into the `node_pool` the node is in
  */
 struct Node {
-    std::uint8_t byte = 0;
     std::uint64_t freq = 0;
+    std::uint16_t left = NO_NODE, right = NO_NODE;
+    std::uint8_t byte = 0;
     node_type_t type = DATA;
-    Node *left = nullptr, *right = nullptr;
 
+    Node() = default;
     Node(std::uint8_t byte, std::uint64_t freq, node_type_t type = DATA) {
       this->byte = byte;
       this->freq = freq;
       this->type = type;
     }
+};
 
-    ~Node() {
-      if (this->left != nullptr) {
-        delete this->left;
-        this->left = nullptr;
-      }
-      if (this->right != nullptr) {
-        delete this->right;
-        this->right = nullptr;
-      }
-    }
+/**
+ * @brief every node of a tree in one flat array
+ * @details a huffman tree of 256 symbols has at most `NODES_SIZE` nodes so
+ * they all fit without allocating anything, the whole tree is thrown away at
+ * once with the pool
+ */
+class node_pool {
+    Node nodes[NODES_SIZE];
+    std::uint16_t count = 0;
 
-    int height(const Node *const node) const {
-      if (node == nullptr)
+    int height(std::uint16_t index) const {
+      if (index == NO_NODE)
         return 0;
 
-      return std::max(height(node->left), height(node->right)) + 1;
+      const Node &node = nodes[index];
+      return std::max(height(node.left), height(node.right)) + 1;
     }
 
+public:
     /**
-     * @brief calculates the height of the tree
+     * @brief adds a node to the pool
+     * @return the index of the node, `NO_NODE` if the pool is full
+     */
+    std::uint16_t add(std::uint8_t byte, std::uint64_t freq,
+                      node_type_t type = DATA) {
+      if (count == NODES_SIZE) {
+        return NO_NODE;
+      }
+      nodes[count] = Node(byte, freq, type);
+      return count++;
+    }
+
+    Node &operator[](std::uint16_t index) { return this->nodes[index]; }
+    const Node &operator[](std::uint16_t index) const {
+      return this->nodes[index];
+    }
+
+    std::uint16_t size() const { return count; }
+
+    /**
+     * @brief calculates the height of the tree under `root`
      * @return returns the height
      */
-    int height() const {
-      return height(this);
+    int tree_height(std::uint16_t root) const {
+      return height(root);
     }
 
-    void __attribute__((noinline)) print_tree(int indent = 0) {
-      if (right != nullptr) {
-        right->print_tree(indent + 4);
+    void __attribute__((noinline)) print_tree(std::ostream &out,
+                                              std::uint16_t index,
+                                              int indent = 0) const {
+      const Node &node = nodes[index];
+      if (node.right != NO_NODE) {
+        print_tree(out, node.right, indent + 4);
       }
       if (indent) {
-        std::cout << std::setw(indent) << " ";
+        out << std::setw(indent) << " ";
       }
-      std::cout << std::hex << +byte << "\n ";
-      if (left != nullptr) {
-        left->print_tree(indent + 4);
+      out << std::hex << +node.byte << std::dec << "\n ";
+      if (node.left != NO_NODE) {
+        print_tree(out, node.left, indent + 4);
       }
     }
-
-    friend bool operator<(const Node &left, const Node &right) {
-      return left.freq < right.freq;
-    }
 };
 
 /**
  * @brief the priority queue for the huffman algorithm
+ * @details holds indices of nodes in a `node_pool`, ordered by frequency
  */
 class Heap {
+    const node_pool &pool;
     int size = 0;
-    Node *nodes[NODES_SIZE] = {0};
-    std::uint32_t paths[UCHAR_MAX + 1] = {0};
+    std::uint16_t nodes[NODES_SIZE] = {0};
 
 public:
+    explicit Heap(const node_pool &pool) : pool(pool) {}
+
     /**
      * @brief removes the top item from the queue and return it
-     * @return a pointer to the to the top object
+     * @return the index of the top node
      */
-    Node *pop(void);
+    std::uint16_t pop(void);
 
     /**
      * @brief only fetches the top value from the queue
      * @details if the heap is empty it's undefined behavior
-     * @return returns a reference to the top object
+     * @return returns the index of the top node
      */
-    Node *peek(void) const;
+    std::uint16_t peek(void) const;
 
     /**
      * @brief inserts a node into the queue
      * @return void
      */
-    void insert(Node *node);
+    void insert(std::uint16_t node);
 
-    Node *operator[](std::uint8_t index) { return this->nodes[index]; }
+    std::uint16_t operator[](std::uint16_t index) { return this->nodes[index]; }
 
     /**
      *
@@ -107,15 +135,6 @@ public:
      */
     int get_size(void) { return this->size; }
 
-    ~Heap() {
-      for (std::uint8_t i = 0; i < this->size; i++) {
-        if (this->nodes[i] != nullptr) {
-          delete this->nodes[i];
-          this->nodes[i] = nullptr;
-        }
-      }
-    }
-
 private:
     /**
      * @brief orders the nodes correctly
@@ -124,26 +143,25 @@ private:
     void heapify(const std::uint16_t index);
 
     /**
-     * @brief      swaps two nodes also swaps the path for the two
+     * @brief compares the frequencies of the nodes at two heap positions
+     */
+    bool less(std::uint16_t a, std::uint16_t b) const {
+      return pool[this->nodes[a]].freq < pool[this->nodes[b]].freq;
+    }
+
+    /**
+     * @brief      swaps two nodes
      *
      * @param      smallest index
      * @param      index to swap
      *
      * @return     void
      */
-    void swap(std::uint8_t smallest, std::uint8_t index) {
-      Node *swap_node = this->nodes[smallest];
+    void swap(std::uint16_t smallest, std::uint16_t index) {
+      std::uint16_t swap_node = this->nodes[smallest];
       this->nodes[smallest] = this->nodes[index];
       this->nodes[index] = swap_node;
     }
-
-    /**
-     * @brief checks if a given index is a leaf
-     * @return bool
-     */
-    bool isLeaf(std::uint8_t index) {
-      return this->nodes[index * 2] == nullptr && this->nodes[index * 2 + 1];
-    }
 };
 
 #endif /* HEAP_H */
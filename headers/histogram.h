@@ -0,0 +1,32 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <climits>
+#include <cstdint>
+
+/* the ways to count, `HISTOGRAM_AUTO` picks the fastest the cpu supports */
+enum histogram_kernel_t : std::uint8_t {
+  HISTOGRAM_AUTO,
+  HISTOGRAM_SCALAR,
+  HISTOGRAM_SSE2,
+  HISTOGRAM_AVX2,
+};
+
+/**
+ * @brief checks if the kernel can run on this cpu
+ */
+bool histogram_supported(histogram_kernel_t kernel);
+
+/**
+ * @brief counts every byte of `data`, the counts are added to `frequencies`
+ * @details every kernel counts into 8 interleaved 32 bit tables so increments
+ * of the same byte don't wait on each other, the tables are summed at the end.
+ * The vector kernels load 16 or 32 bytes at a time and a chunk that is a
+ * single repeated byte is counted with one add.
+ * @param kernel an unsupported kernel falls back to the scalar one
+ */
+void histogram(const std::uint8_t *data, std::size_t size,
+               std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+               histogram_kernel_t kernel = HISTOGRAM_AUTO);
+
+#endif /* HISTOGRAM_H */
@@ -1,26 +1,233 @@
 #ifndef HUFFMAN_H
 #define HUFFMAN_H
+#include "path.h"
+#include <climits>
 #include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <vector>
 
 
+/**
+ * @brief set in the tree size of the header when the header only contains
+ * the code lengths of a canonical code instead of the paths
+ */
+constexpr std::uint16_t CANONICAL_FLAG = 0x8000;
+
+/**
+ * @brief bounds for `huffman_options::max_code_len`, 8 bits always fit every
+ * byte and 24 is the longest code the decode table handles
+ */
+constexpr std::uint8_t MIN_CODE_LEN_LIMIT = 8;
+constexpr std::uint8_t MAX_CODE_LEN_LIMIT = 24;
+
+/**
+ * @brief settings for the compression
+ */
+struct huffman_options {
+  /* store canonical codes, the header then only has the code lengths */
+  bool canonical = false;
+  /* longest path allowed, deeper trees are flattened with package-merge */
+  std::uint8_t max_code_len = 15;
+  /* size of the blocks compressed on their own, 0 writes a single stream */
+  std::size_t block_size = 1 << 20;
+  /* threads compressing and decompressing blocks, 0 uses every core */
+  unsigned threads = 0;
+  /*
+    symbols between the sync points of a block, a block is decoded in
+    parallel from its sync points, 0 doesn't write any
+  */
+  std::uint32_t sync_interval = 0;
+  /*
+    code every block as 4 interleaved streams so they decode side by side,
+    only used when there are no sync points
+  */
+  bool interleave = false;
+  /*
+    also code every block with order-1 contexts, where the byte before picks
+    the code table, and keep that if it's smaller. Not with sync points.
+  */
+  bool context = false;
+  /* find repeated strings with lz77 before the huffman coding of a block */
+  bool lz77 = false;
+  /* how far back a match can start, at most 64K */
+  std::uint32_t window = 1 << 16;
+  /* positions compared when looking for a match, more finds longer ones */
+  std::uint32_t search_depth = 16;
+  /*
+    file written to, "-" is stdout, empty writes <file>.huff when compressing
+    and "output" when decompressing or stdout if the input is stdin
+  */
+  std::string output;
+};
+
+/* `-1` is the fastest level and `-9` compresses the most */
+constexpr int MIN_LEVEL = 1;
+constexpr int MAX_LEVEL = 9;
+
+/**
+ * @brief sets the block size, lz77 search and code length limit of a level
+ * @details 1 and 2 are huffman coding only, 3 and up add lz77 with a window
+ * and search depth growing with the level and 7 and up also try order-1
+ * contexts, the defaults are level 2. Every
+ * level writes the same format so any of them decompresses the same way.
+ */
+extern void huffman_level(int level, huffman_options &options);
+
 /**
  * @brief      huffman compression for a file
  *
  * @details    uses huffman coding to compress a file
  *
  * @param      filename file to compress
+ * @param      options how to compress it
  *
  * @return     void
  */
-extern void huffman_compression(const std::string &filename);
+extern void huffman_compression(const std::string &filename,
+                                const huffman_options &options = {});
+class mapped_file;
+
+/**
+ * @brief compresses `in` into a container written to `out`
+ * @details the container is indexed if `size` is known and `out` can seek
+ * back to where the container starts, which doesn't have to be the start of
+ * the file, and the index has room for every block, otherwise it's streamed
+ * @param size size of the input, `UNKNOWN_SIZE` if it's a pipe
+ * @param mapped the input mapped into memory, read instead of `in`
+ * @return false if the block size isn't 1 to UINT32_MAX, a block couldn't be
+ * compressed or the input changed size
+ */
+extern bool huffman_compress_stream(FILE *in, FILE *out, std::uint64_t size,
+                                    const huffman_options &options,
+                                    const mapped_file *mapped = nullptr);
+
 /**
  * @brief decompresses a file huffman compressed filename
  * @param filename of the file
- * @return void
+ * @param options only the amount of threads is used
+ * @return false if it couldn't be decoded, a partly written output is removed
+ */
+extern bool huffman_decompress(const std::string &filename,
+                               const huffman_options &options = {});
+
+/**
+ * @brief builds the huffman tree for the frequencies and the paths through it
+ * @details the paths are limited to `options.max_code_len` bits and made
+ * canonical if `options.canonical` is set
+ * @return false if the codes couldn't be limited, which is logged at info
+ */
+extern bool huffman_paths(const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                          const huffman_options &options,
+                          path_t (&paths)[UCHAR_MAX + 1]);
+
+/**
+ * @brief huffman codes data with canonical codes
+ * @details appends the code lengths, the amount of bits, the sync points and
+ * the bits. A sync point is the bit offset of every `options.sync_interval`th
+ * symbol so the data can be decoded from there on its own.
+ * @return false if the data couldn't be coded
+ */
+extern bool huffman_encode(const std::uint8_t *data, std::size_t size,
+                           const huffman_options &options,
+                           std::vector<std::uint8_t> &out);
+
+/**
+ * @brief `huffman_encode` with the histogram and the canonical paths from
+ * `huffman_paths` already computed
+ */
+extern bool huffman_encode(const std::uint8_t *data, std::size_t size,
+                           const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                           const path_t (&paths)[UCHAR_MAX + 1],
+                           const huffman_options &options,
+                           std::vector<std::uint8_t> &out);
+
+/**
+ * @brief the amount of bytes `huffman_encode` appends for data with these
+ * frequencies and paths, without coding anything
+ * @details exact, except with `options.interleave` when it's the size
+ * `huffman_encode_interleaved` appends at most
+ */
+extern std::size_t
+huffman_encoded_size(const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                     const path_t (&paths)[UCHAR_MAX + 1], std::size_t size,
+                     const huffman_options &options);
+
+/* the streams of an interleaved block */
+constexpr std::size_t HUFFMAN_STREAMS = 4;
+
+/**
+ * @brief `huffman_encode` into `HUFFMAN_STREAMS` interleaved streams
+ * @details byte `i` goes to stream `i % HUFFMAN_STREAMS`, every stream has
+ * its own bitwriter. Appends the code lengths, the amount of bits in every
+ * stream and the streams one after another, each padded to a whole byte.
+ * Without a dependency between the streams the decoder reads them all in
+ * the same loop.
+ */
+extern bool huffman_encode_interleaved(
+    const std::uint8_t *data, std::size_t size,
+    const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+    const path_t (&paths)[UCHAR_MAX + 1], std::vector<std::uint8_t> &out);
+
+/**
+ * @brief decodes data written by `huffman_encode_interleaved`
+ * @return the amount of bytes read from `data`, 0 if it's corrupt or doesn't
+ * decode into `out_size` bytes
+ */
+extern std::size_t huffman_decode_interleaved(const std::uint8_t *data,
+                                              std::size_t size,
+                                              std::uint8_t *out,
+                                              std::size_t out_size);
+
+/**
+ * @brief decodes data written by `huffman_encode`
+ * @param out has to fit exactly `out_size` bytes
+ * @param threads the pieces between the sync points are decoded on this many
+ * threads
+ * @return the amount of bytes read from `data`, 0 if it's corrupt or doesn't
+ * decode into `out_size` bytes
+ */
+extern std::size_t huffman_decode(const std::uint8_t *data, std::size_t size,
+                                  std::uint8_t *out, std::size_t out_size,
+                                  unsigned threads = 1);
+
+/**
+ * @brief the most code tables an order-1 block has, the contexts share them.
+ * Their decode tables together stay small enough for the L2 cache.
+ */
+constexpr std::size_t MAX_CONTEXT_TABLES = 16;
+
+/**
+ * @brief huffman codes data with a code table picked by the previous byte
+ * @details the 256 contexts, i.e. the byte before, are grouped into at most
+ * `MAX_CONTEXT_TABLES` groups with similar histograms and every group gets
+ * canonical codes of its own, the first byte is coded in context 0. Smaller
+ * blocks get fewer tables so the header doesn't outweigh what they save.
+ * Appends
+ * ```
+ * struct {
+ *     uint8_t table_count;
+ *     uint8_t contexts[128]; // the table of context 2i in the low nibble
+ *                            // and of 2i + 1 in the high one
+ *     uint8_t lengths[table_count][]; // same as in the single stream
+ *     uint64_t total_bits;
+ *     uint8_t bits[(total_bits + 7) / 8];
+ * };
+ * ```
+ * @return false if the data is empty or the codes couldn't be limited
+ */
+extern bool huffman_encode_context(const std::uint8_t *data, std::size_t size,
+                                   const huffman_options &options,
+                                   std::vector<std::uint8_t> &out);
+
+/**
+ * @brief decodes data written by `huffman_encode_context`
+ * @return the amount of bytes read from `data`, 0 if it's corrupt or doesn't
+ * decode into `out_size` bytes
  */
-extern void huffman_decompress(const std::string &filename);
+extern std::size_t huffman_decode_context(const std::uint8_t *data,
+                                          std::size_t size, std::uint8_t *out,
+                                          std::size_t out_size);
 
 #endif // HUFFMAN_H
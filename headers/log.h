@@ -0,0 +1,51 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <iostream>
+
+/*
+  everything is logged to stderr so it never mixes with data written to
+  stdout, nothing is logged unless asked for with -v
+*/
+enum log_level_t : int { LOG_OFF, LOG_INFO, LOG_DEBUG, LOG_TRACE };
+
+/*
+  the most verbose level compiled in, anything above it compiles to nothing,
+  release builds only keep the info messages
+*/
+#ifndef TIRA_LOG_LEVEL
+#ifdef NDEBUG
+#define TIRA_LOG_LEVEL LOG_INFO
+#else
+#define TIRA_LOG_LEVEL LOG_TRACE
+#endif
+#endif
+
+/* the level picked at runtime, raised by -v */
+inline log_level_t log_level = LOG_OFF;
+
+/**
+ * @brief writes `message` to stderr if `level` is enabled
+ * @details `message` is a chain of `<<` operands and is not evaluated at all
+ * when the level is off, the stream flags are restored afterwards so a
+ * `std::hex` doesn't leak into the next message
+ */
+#define TIRA_LOG(level, message)                                               \
+  do {                                                                         \
+    if constexpr ((level) <= TIRA_LOG_LEVEL) {                                 \
+      if ((level) <= log_level) {                                              \
+        const std::ios_base::fmtflags log_flags_ = std::cerr.flags();          \
+        std::cerr << message;                                                  \
+        std::cerr.flags(log_flags_);                                           \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+/* for logging that isn't a single message, e.g. dumping a tree */
+#define LOG_ENABLED(level) ((level) <= TIRA_LOG_LEVEL && (level) <= log_level)
+
+#define LOG_INFO(message) TIRA_LOG(LOG_INFO, message)
+#define LOG_DEBUG(message) TIRA_LOG(LOG_DEBUG, message)
+#define LOG_TRACE(message) TIRA_LOG(LOG_TRACE, message)
+
+#endif /* LOG_H */
@@ -0,0 +1,70 @@
+#ifndef LZ77_H
+#define LZ77_H
+
+#include "huffman.h"
+#include <cstdint>
+#include <vector>
+
+/*
+  the lz77 stage, a block is parsed into sequences of literals followed by a
+  match that copies bytes from earlier in the block:
+
+      struct {
+          length literal_count;
+          uint8_t literals[literal_count];
+          length match_length; // minus LZ77_MIN_MATCH
+          uint16_t distance;   // minus 1, back from the current position
+      } sequences[];
+
+  the last sequence ends after its literals. A length is written as bytes of
+  255 followed by the rest, like 300 is 255, 45. The parts go to separate
+  streams so every stream gets its own huffman table: the literals, the
+  lengths, and the low and high bytes of the distances. The payload of an
+  `LZ77_BLOCK` is the number of sequences and the four streams, each
+  compressed as a block of its own.
+*/
+
+/* the shortest match worth coding, a shorter one costs more than the literals */
+constexpr std::uint32_t LZ77_MIN_MATCH = 4;
+/* the distances are 16 bits */
+constexpr std::uint32_t LZ77_MAX_WINDOW = 1 << 16;
+constexpr std::uint32_t LZ77_MIN_WINDOW = 1 << 8;
+
+/**
+ * @brief the streams a block is parsed into
+ */
+struct lz77_streams {
+  std::vector<std::uint8_t> literals;
+  std::vector<std::uint8_t> lengths;
+  std::vector<std::uint8_t> distance_low;
+  std::vector<std::uint8_t> distance_high;
+  std::uint32_t sequences = 0;
+};
+
+/**
+ * @brief finds the matches with hash chains and parses the data into streams
+ * @details every position is hashed by its first 4 bytes, the positions with
+ * the same hash are chained from the newest and at most
+ * `options.search_depth` of them within `options.window` bytes are compared,
+ * the longest match is taken
+ */
+void lz77_parse(const std::uint8_t *data, std::size_t size,
+                const huffman_options &options, lz77_streams &streams);
+
+/**
+ * @brief parses the data and appends the payload of an `LZ77_BLOCK`
+ * @return false if a stream couldn't be compressed
+ */
+bool lz77_encode(const std::uint8_t *data, std::size_t size,
+                 const huffman_options &options,
+                 std::vector<std::uint8_t> &out);
+
+/**
+ * @brief decompresses the payload of an `LZ77_BLOCK`
+ * @param out has to fit `size` bytes
+ * @return false if the payload is corrupt or doesn't decode to `size` bytes
+ */
+bool lz77_decode(const std::uint8_t *payload, std::size_t payload_size,
+                 std::uint8_t *out, std::size_t size, unsigned threads = 1);
+
+#endif /* LZ77_H */
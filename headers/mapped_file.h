@@ -0,0 +1,44 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief a file mapped into memory
+ * @details the coders read and write the mapping directly so the data isn't
+ * copied through a heap buffer and the page cache, the mapping is removed
+ * when this goes out of scope
+ */
+class mapped_file {
+  std::uint8_t *bytes = nullptr;
+  std::size_t length = 0;
+  int fd = -1;
+
+  void close();
+
+public:
+  mapped_file() = default;
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+  ~mapped_file() { close(); }
+
+  /**
+   * @brief maps a regular file to read
+   * @return false if it isn't a regular file or can't be mapped, an empty
+   * file is mapped but has no data
+   */
+  bool open_read(const std::string &filename);
+
+  /**
+   * @brief creates or truncates the file, sizes it to `size` bytes and maps
+   * it to write
+   * @return false if it can't be created or mapped
+   */
+  bool open_write(const std::string &filename, std::size_t size);
+
+  std::uint8_t *data() const { return bytes; }
+  std::size_t size() const { return length; }
+};
+
+#endif /* MAPPED_FILE_H */
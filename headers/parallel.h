@@ -0,0 +1,64 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/**
+ * @returns the amount of threads to use, 0 means one per core
+ */
+inline unsigned thread_count(unsigned threads) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  return std::max(threads, 1u);
+}
+
+/*
+  the threads a `parallel_for` on this thread may use, 0 outside of one. A
+  nested call gets the share of the threads its outer call didn't use, so
+  they don't multiply
+*/
+inline thread_local unsigned parallel_share = 0;
+
+/**
+ * @brief calls `fn(i)` for every i in [0, count) spread over `threads` threads
+ * @details the indices are handed out one at a time so uneven work balances
+ * itself, the calling thread works as well and returns once all are done. A
+ * call from inside `fn` runs on at most `threads` divided by the threads the
+ * outer call runs on, serially if the outer one uses all of them.
+ */
+template <typename F>
+void parallel_for(const std::size_t count, unsigned threads, F &&fn) {
+  threads = thread_count(threads);
+  if (parallel_share != 0) {
+    threads = std::min(threads, parallel_share);
+  }
+  const unsigned used =
+      std::max<std::size_t>(std::min<std::size_t>(threads, count), 1);
+  const unsigned share = threads / used;
+
+  std::atomic<std::size_t> next{0};
+  auto worker = [&]() {
+    const unsigned previous = parallel_share;
+    parallel_share = share;
+    for (std::size_t i = next++; i < count; i = next++) {
+      fn(i);
+    }
+    parallel_share = previous;
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < used; i++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+}
+
+#endif /* PARALLEL_H */
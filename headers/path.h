@@ -0,0 +1,31 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include "bitstring.h"
+#include "log.h"
+#include <cstdint>
+#include <fstream>
+
+/*
+  needed to keep track of how long it actually is
+  e.g. if the path would be 1 then you'd not know if there's
+  4 0's before it
+*/
+struct path_t {
+  std::uint8_t character = 0;
+  std::uint8_t len = 0;
+  bitstring path = {0};
+
+  friend std::ostream &operator<<(std::ostream &stream, const path_t &path) {
+    LOG_TRACE("writing byte: 0x" << std::hex << +path.character
+                                 << ", to: " << stream.tellp() << "\n");
+    stream.write((const char *)&path.character, sizeof(character));
+    LOG_TRACE("length: " << +path.len << ", to: " << stream.tellp() << "\n");
+    stream.write((const char *)&path.len, sizeof(len));
+    LOG_TRACE("writing to: " << stream.tellp() << ", path: " << path.path);
+    path.path.write_tree_path(stream);
+    return stream;
+  }
+};
+
+#endif /* PATH_H */
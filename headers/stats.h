@@ -0,0 +1,133 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+  time spent in every stage and counters, collected from every thread into
+  one process wide set. Nothing is measured unless enabled with --stats or
+  `tira_enable_stats`, a disabled timer is a single predictable branch.
+  Building with -DTIRA_STATS=0 compiles all of it out.
+*/
+#ifndef TIRA_STATS
+#define TIRA_STATS 1
+#endif
+
+enum stat_timer_t : int {
+  STAT_READ,
+  STAT_HISTOGRAM,
+  /* code lengths or the huffman tree, once for every block */
+  STAT_TREE,
+  /* the codes from the lengths or the paths through the tree */
+  STAT_PATHS,
+  /* finding the matches, the streams it makes are timed as blocks */
+  STAT_LZ77,
+  STAT_ENCODE,
+  STAT_WRITE,
+  STAT_DECODE,
+  STAT_TIMERS,
+};
+
+enum stat_counter_t : int {
+  STAT_BYTES_IN,
+  STAT_BYTES_OUT,
+  /* bytes coded with huffman codes */
+  STAT_SYMBOLS,
+  /* blocks coded or decoded, the streams of an lz77 block count too */
+  STAT_BLOCKS,
+  /* times a tree or code was built or read back to decode a block */
+  STAT_TREES,
+  /* the longest code, i.e. the height of the deepest tree */
+  STAT_TREE_HEIGHT,
+  STAT_COUNTERS,
+};
+
+/**
+ * @brief a copy of the stats at one point
+ */
+struct tira_stats {
+  std::uint64_t nanoseconds[STAT_TIMERS] = {0};
+  std::uint64_t counters[STAT_COUNTERS] = {0};
+
+  /**
+   * @returns a table of the timers and counters
+   */
+  std::string summary() const;
+
+  /**
+   * @returns the stats as a json object
+   */
+  std::string json() const;
+};
+
+namespace stats_detail {
+inline std::atomic<bool> enabled{false};
+inline std::atomic<std::uint64_t> nanoseconds[STAT_TIMERS];
+inline std::atomic<std::uint64_t> counters[STAT_COUNTERS];
+} // namespace stats_detail
+
+inline bool stats_enabled() {
+  return TIRA_STATS && stats_detail::enabled.load(std::memory_order_relaxed);
+}
+
+void enable_stats(bool enabled);
+void reset_stats();
+tira_stats get_stats();
+
+inline void stat_add(stat_counter_t counter, std::uint64_t amount) {
+  if (stats_enabled()) {
+    stats_detail::counters[counter].fetch_add(amount,
+                                              std::memory_order_relaxed);
+  }
+}
+
+inline void stat_max(stat_counter_t counter, std::uint64_t value) {
+  if (stats_enabled()) {
+    std::uint64_t current =
+        stats_detail::counters[counter].load(std::memory_order_relaxed);
+    while (current < value &&
+           !stats_detail::counters[counter].compare_exchange_weak(
+               current, value, std::memory_order_relaxed)) {
+    }
+  }
+}
+
+/**
+ * @brief adds the time until it goes out of scope to a timer
+ */
+class stat_scope {
+  stat_timer_t timer;
+  bool running;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  explicit stat_scope(stat_timer_t timer)
+      : timer(timer), running(stats_enabled()) {
+    if (running) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+  stat_scope(const stat_scope &) = delete;
+  stat_scope &operator=(const stat_scope &) = delete;
+
+  ~stat_scope() { stop(); }
+
+  /**
+   * @brief stops early, before the end of the scope
+   */
+  void stop() {
+    if (running) {
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      stats_detail::nanoseconds[timer].fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+              .count(),
+          std::memory_order_relaxed);
+      running = false;
+    }
+  }
+};
+
+#endif /* STATS_H */
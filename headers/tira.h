@@ -0,0 +1,218 @@
+#ifndef TIRA_H
+#define TIRA_H
+
+#include "block.h"
+#include "huffman.h"
+#include "stats.h"
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/*
+  the library interface, compresses from memory into memory without any
+  files. The output is the same container `tira -c` writes, so either side
+  can be done with the command line tool.
+*/
+
+enum tira_status_t : int {
+  TIRA_OK = 0,
+  /* the output buffer is too small, `tira_compress_bound` is always enough */
+  TIRA_DST_TOO_SMALL = -1,
+  /* the data isn't a valid container or a block doesn't decode */
+  TIRA_CORRUPT = -2,
+  /* a container version or the single stream format this can't read */
+  TIRA_UNSUPPORTED = -3,
+  /* e.g. a block size over 4 GB */
+  TIRA_INVALID_OPTIONS = -4,
+  /* a block couldn't be compressed */
+  TIRA_ENCODE_FAILED = -5,
+  /* the stream was already finished */
+  TIRA_FINISHED = -6,
+};
+
+/**
+ * @returns a short description of the status
+ */
+const char *tira_status_string(tira_status_t status);
+
+/**
+ * @brief starts or stops collecting the stage timers and counters, they're
+ * shared by every compressor and decompressor in the process
+ */
+void tira_enable_stats(bool enabled);
+
+/**
+ * @brief sets every timer and counter back to 0
+ */
+void tira_reset_stats();
+
+/**
+ * @returns the stats collected since the last reset
+ */
+tira_stats tira_get_stats();
+
+/**
+ * @brief the largest container `tira_compressor` can write for `size` bytes
+ * @details every block is at most its header larger than its data, plus the
+ * container header and the index
+ */
+std::size_t tira_compress_bound(std::size_t size,
+                                const huffman_options &options = {});
+
+/**
+ * @brief reads the size the container decompresses to
+ * @param size set to `UNKNOWN_SIZE` for a streamed container, those only
+ * know it once every block has been decoded
+ */
+tira_status_t tira_decompressed_size(const std::uint8_t *src,
+                                     std::size_t src_size,
+                                     std::uint64_t &size);
+
+/**
+ * @brief compresses buffers into indexed containers
+ * @details the buffers the blocks are encoded into are kept between calls so
+ * compressing many inputs with the same compressor doesn't allocate them
+ * again, a compressor can't be used from many threads at once
+ */
+class tira_compressor {
+  huffman_options options;
+  std::vector<std::vector<std::uint8_t>> encoded;
+
+public:
+  /**
+   * @param options a block size of 0 uses the default, the output is always
+   * a container
+   */
+  explicit tira_compressor(const huffman_options &options = {});
+
+  const huffman_options &get_options() const { return options; }
+  void set_options(const huffman_options &options);
+
+  /**
+   * @brief compresses `src` into `dst`
+   * @param written the size of the container, only set on success
+   */
+  tira_status_t compress(const std::uint8_t *src, std::size_t src_size,
+                         std::uint8_t *dst, std::size_t dst_capacity,
+                         std::size_t &written);
+};
+
+/**
+ * @brief decompresses indexed and streamed containers
+ * @details the blocks of an indexed container are decoded in parallel
+ * straight into `dst`, a streamed one is decoded block by block
+ */
+class tira_decompressor {
+  unsigned threads;
+
+public:
+  /**
+   * @param threads threads to decode on, 0 uses every core
+   */
+  explicit tira_decompressor(unsigned threads = 0) : threads(threads) {}
+
+  /**
+   * @brief decompresses the container in `src` into `dst`
+   * @param written the decompressed size, only set on success
+   */
+  tira_status_t decompress(const std::uint8_t *src, std::size_t src_size,
+                           std::uint8_t *dst, std::size_t dst_capacity,
+                           std::size_t &written);
+};
+
+/**
+ * @brief receives the output of the streaming encoder and decoder, the data
+ * is only valid during the call
+ */
+using tira_sink = std::function<void(const std::uint8_t *data, std::size_t size)>;
+
+/**
+ * @brief compresses data that arrives in pieces into a streamed container
+ * @details the data is collected until a block is full, which is compressed
+ * and passed to the sink right away, so at most a block of input and its
+ * compressed block are held at any time
+ */
+class tira_stream_encoder {
+  huffman_options options;
+  tira_sink sink;
+  std::vector<std::uint8_t> pending;
+  std::vector<std::uint8_t> encoded;
+  bool started = false;
+  bool finished = false;
+
+  tira_status_t encode(const std::uint8_t *data, std::size_t size);
+
+public:
+  /**
+   * @param options a block size of 0 uses the default
+   */
+  explicit tira_stream_encoder(tira_sink sink,
+                               const huffman_options &options = {});
+
+  /**
+   * @brief adds data to the stream, every block it fills is written out
+   */
+  tira_status_t write(const std::uint8_t *data, std::size_t size);
+
+  /**
+   * @brief writes out the data collected so far as a shorter block, so the
+   * decoder can return everything written until now
+   */
+  tira_status_t flush();
+
+  /**
+   * @brief flushes and ends the container, `reset` starts a new one
+   */
+  tira_status_t finish();
+
+  /**
+   * @brief forgets the current container, the next write starts a new one
+   */
+  void reset();
+};
+
+/**
+ * @brief decompresses a container that arrives in pieces of any size
+ * @details every block is decoded and passed to the sink as soon as all of
+ * it has arrived, so at most one compressed and one decompressed block are
+ * held. Reads streamed and indexed containers.
+ */
+class tira_stream_decoder {
+  tira_sink sink;
+  container_header header;
+  std::vector<std::uint8_t> pending;
+  std::vector<std::uint8_t> decoded;
+  /* bytes of the index still to skip, it isn't needed in order */
+  std::uint64_t index_left = 0;
+  std::uint32_t blocks = 0;
+  bool started = false;
+  bool finished = false;
+  tira_status_t status = TIRA_OK;
+
+  tira_status_t decode();
+
+public:
+  explicit tira_stream_decoder(tira_sink sink) : sink(std::move(sink)) {}
+
+  /**
+   * @brief adds the next piece of the container
+   * @return an error once the data is found to be corrupt, every later call
+   * returns it as well
+   */
+  tira_status_t write(const std::uint8_t *data, std::size_t size);
+
+  /**
+   * @return `TIRA_CORRUPT` if the container hasn't ended
+   */
+  tira_status_t finish();
+
+  /**
+   * @returns true once the whole container has been decoded
+   */
+  bool done() const { return finished; }
+
+  void reset();
+};
+
+#endif /* TIRA_H */
@@ -2,124 +2,338 @@
 #define VEC_H
 
 #include <algorithm>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
-#include <stdexcept>
 #include <memory>
-#include <cassert>
-#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 /* simple implementation of the stl vector, implemented due to course
  * restrictions
  * TODO: add initializer list
+ *
+ * Only the first `size()` elements are constructed, the rest of the capacity
+ * is raw memory. Growing copies just those elements, with memcpy when `T` is
+ * trivially copyable and by moving them otherwise, moving a vec only swaps
+ * pointers. The memory comes from `Allocator`, so a vec can live in an arena.
  */
-template <typename T> class vec {
+template <typename T, typename Allocator = std::allocator<T>> class vec {
+  using traits = std::allocator_traits<Allocator>;
+
+  Allocator allocator;
+  T *array = nullptr;
   std::size_t current_index = 0;
-  std::size_t array_capacity = 10;
-  std::unique_ptr<T[]> array = std::make_unique<T[]>(array_capacity); /* smart pointer? */
+  std::size_t array_capacity = 0;
 
 public:
+  using value_type = T;
+  using allocator_type = Allocator;
+  using iterator = T *;
+  using const_iterator = const T *;
+
   /**
-   * @brief defaults to array_size = 10
+   * @brief smallest capacity the first push allocates
    */
+  static constexpr std::size_t MIN_CAPACITY = 8;
+
   vec() = default;
 
-  vec(const std::size_t size) {
-    array_capacity = size;
-    array.reset(new T[size]());
+  explicit vec(const Allocator &allocator) : allocator(allocator) {}
+
+  /**
+   * @brief `size` value initialised elements, i.e. zeroes for numbers
+   */
+  explicit vec(const std::size_t size, const Allocator &allocator = Allocator())
+      : allocator(allocator) {
+    resize(size);
   }
 
-  vec(const vec &v) {
-    array.reset(new T[v.array_capacity]);
-    current_index = v.current_index;
-    array_capacity = v.array_capacity;
-    std::copy(v.array.get(), v.array.get() + v.array_capacity, array.get());
+  vec(const vec &v)
+      : allocator(
+            traits::select_on_container_copy_construction(v.allocator)) {
+    copy_from(v);
   }
 
-  vec(vec &&temp) {
-    current_index = std::exchange(temp.current_index, 0);
-    array_capacity = std::exchange(temp.array_capacity, 0);
-    array = std::exchange(temp.array, new T[temp.array_capacity]());
+  vec(vec &&temp) noexcept
+      : allocator(std::move(temp.allocator)),
+        array(std::exchange(temp.array, nullptr)),
+        current_index(std::exchange(temp.current_index, 0)),
+        array_capacity(std::exchange(temp.array_capacity, 0)) {}
+
+  ~vec() { release(); }
+
+  vec &operator=(const vec &other) {
+    if (this != &other) {
+      if constexpr (traits::propagate_on_container_copy_assignment::value) {
+        if (allocator != other.allocator) {
+          release();
+          allocator = other.allocator;
+        }
+      }
+      clear();
+      copy_from(other);
+    }
+    return *this;
+  }
+
+  vec &operator=(vec &&other) noexcept(
+      traits::propagate_on_container_move_assignment::value ||
+      traits::is_always_equal::value) {
+    if (this == &other) {
+      return *this;
+    }
+    if (traits::propagate_on_container_move_assignment::value ||
+        allocator == other.allocator) {
+      release();
+      if constexpr (traits::propagate_on_container_move_assignment::value) {
+        allocator = std::move(other.allocator);
+      }
+      array = std::exchange(other.array, nullptr);
+      current_index = std::exchange(other.current_index, 0);
+      array_capacity = std::exchange(other.array_capacity, 0);
+    } else {
+      /* the memory belongs to another allocator, only the elements can move */
+      clear();
+      reserve(other.current_index);
+      relocate(other.array, other.current_index, array);
+      current_index = std::exchange(other.current_index, 0);
+    }
+    return *this;
   }
 
   /**
    * @brief pushes to the back of the vector a value
    */
-  void push_back(const T &val) {
-    if (current_index < array_capacity - 1) {
-      array[current_index++] = val;
-    } else {
-      realloc();
-      array[current_index++] = val;
+  void push_back(const T &val) { emplace_back(val); }
+
+  void push_back(T &&val) { emplace_back(std::move(val)); }
+
+  /**
+   * @brief constructs an element in place at the back
+   * @returns the new element
+   */
+  template <typename... Args> T &emplace_back(Args &&...args) {
+    if (current_index == array_capacity) {
+      reserve(grown_capacity(current_index + 1));
     }
+    T *element = array + current_index;
+    traits::construct(allocator, element, std::forward<Args>(args)...);
+    current_index++;
+    return *element;
+  }
+
+  void pop_back() {
+    assert(current_index > 0);
+    traits::destroy(allocator, array + --current_index);
   }
 
-  T &back() const {
+  T &back() {
     assert(current_index > 0);
-    return array[current_index-1];
+    return array[current_index - 1];
+  }
+  const T &back() const {
+    assert(current_index > 0);
+    return array[current_index - 1];
   }
 
-  T &front() const { return array[0]; }
+  T &front() {
+    assert(current_index > 0);
+    return array[0];
+  }
+  const T &front() const {
+    assert(current_index > 0);
+    return array[0];
+  }
 
   /**
    * @returns the amount of elements, not necessarely equal to capacity
    */
   inline std::size_t size() const { return current_index; }
   inline std::size_t capacity() const { return array_capacity; }
+  inline bool empty() const { return current_index == 0; }
+
+  T *data() { return array; }
+  const T *data() const { return array; }
+  iterator begin() { return array; }
+  iterator end() { return array + current_index; }
+  const_iterator begin() const { return array; }
+  const_iterator end() const { return array + current_index; }
+
+  allocator_type get_allocator() const { return allocator; }
 
   /**
-   * @brief reserves `n` elemts to the array
+   * @brief makes room for `new_capacity` elements, never shrinks
+   * @details the new capacity isn't constructed, only the live elements are
+   * moved over
    */
   void reserve(const std::size_t new_capacity) {
-    T *new_array = new T[new_capacity]();
-    std::copy(array.get(), array.get() + array_capacity, new_array);
-    array.reset(new_array);
-    array_capacity = new_capacity;
+    if (new_capacity <= array_capacity) {
+      return;
+    }
+    reallocate(new_capacity);
   }
+
   /**
-   * @brief resizes the array to new_size
+   * @brief resizes the array to new_size, new elements are value initialised
    * @param new_size
    */
   void resize(const std::size_t new_size) {
-    if(new_size > this->capacity()) {
-      reserve(new_size * 3 / 2);
+    grow_to(new_size,
+            [this](T *element) { traits::construct(allocator, element); });
+  }
+
+  void resize(const std::size_t new_size, const T &value) {
+    grow_to(new_size, [&](T *element) {
+      traits::construct(allocator, element, value);
+    });
+  }
+
+  /**
+   * @brief resizes the array to new_size, new elements are default
+   * initialised, so bytes and other trivial types are left as whatever the
+   * memory held. For buffers that are written right after.
+   */
+  void resize_uninitialized(const std::size_t new_size) {
+    grow_to(new_size, [](T *element) { ::new ((void *)element) T; });
+  }
+
+  /**
+   * @brief destroys every element, the capacity is kept
+   */
+  void clear() {
+    destroy(array, array + current_index);
+    current_index = 0;
+  }
+
+  /**
+   * @brief frees the capacity that isn't used
+   */
+  void shrink_to_fit() {
+    if (current_index == array_capacity) {
+      return;
     }
-    current_index = new_size;
+    if (current_index == 0) {
+      release();
+      return;
+    }
+    reallocate(current_index);
   }
 
   /**
-   * @brief fetches element `i` from the array, if out of bounds returns the
-   * default constructor
+   * @brief fetches element `i` from the array
+   * @throws std::range_error if out of bounds
    */
-  T &get(const std::size_t index) const {
-    if (index < array_capacity) {
-      return array[index];
-    } else {
+  T &get(const std::size_t index) {
+    if (index >= current_index) {
+      throw std::range_error("error index out of range");
+    }
+    return array[index];
+  }
+  const T &get(const std::size_t index) const {
+    if (index >= current_index) {
       throw std::range_error("error index out of range");
     }
+    return array[index];
   }
 
   /**
-     @brief @see{get}
+     @brief @see{get}, only checked in debug builds
    */
-  T &operator[](const std::size_t index) const { return get(index); }
+  T &operator[](const std::size_t index) {
+    assert(index < current_index);
+    return array[index];
+  }
+  const T &operator[](const std::size_t index) const {
+    assert(index < current_index);
+    return array[index];
+  }
 
-  vec<T> &operator=(const vec &other) {
-    if (this != &other) {
-      if (array_capacity != other.array_capacity) {
-        array.reset(new T[other.array_capacity]);
-        array_capacity = other.array_capacity;
-      }
-      current_index = other.current_index;
-      std::copy(other.array.get(), other.array.get() + other.array_capacity, array.get());
+private:
+  /**
+   * @brief 1.5 times the capacity, or more if that isn't enough
+   */
+  std::size_t grown_capacity(const std::size_t needed) const {
+    return std::max({needed, array_capacity + array_capacity / 2,
+                     MIN_CAPACITY});
+  }
+
+  template <typename Construct>
+  void grow_to(const std::size_t new_size, Construct &&construct) {
+    if (new_size <= current_index) {
+      destroy(array + new_size, array + current_index);
+      current_index = new_size;
+      return;
+    }
+    if (new_size > array_capacity) {
+      reserve(grown_capacity(new_size));
+    }
+    for (; current_index < new_size; current_index++) {
+      construct(array + current_index);
     }
-    return *this;
   }
 
-private:
   /**
-   * @brief reallocates the array
+   * @brief moves `count` elements from `from` into the raw memory at `to`
+   * and destroys the originals
    */
-  void realloc() { reserve(array_capacity * 3 / 2); }
+  void relocate(T *from, const std::size_t count, T *to) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (count != 0) {
+        std::memcpy((void *)to, (const void *)from, count * sizeof(T));
+      }
+    } else {
+      for (std::size_t i = 0; i < count; i++) {
+        traits::construct(allocator, to + i, std::move_if_noexcept(from[i]));
+        traits::destroy(allocator, from + i);
+      }
+    }
+  }
+
+  void reallocate(const std::size_t new_capacity) {
+    T *new_array = traits::allocate(allocator, new_capacity);
+    relocate(array, current_index, new_array);
+    if (array != nullptr) {
+      traits::deallocate(allocator, array, array_capacity);
+    }
+    array = new_array;
+    array_capacity = new_capacity;
+  }
+
+  void copy_from(const vec &other) {
+    reserve(other.current_index);
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (other.current_index != 0) {
+        std::memcpy((void *)array, (const void *)other.array,
+                    other.current_index * sizeof(T));
+      }
+      current_index = other.current_index;
+    } else {
+      for (; current_index < other.current_index; current_index++) {
+        traits::construct(allocator, array + current_index,
+                          other.array[current_index]);
+      }
+    }
+  }
+
+  void destroy(T *first, T *last) {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (; first != last; first++) {
+        traits::destroy(allocator, first);
+      }
+    }
+  }
+
+  void release() {
+    clear();
+    if (array != nullptr) {
+      traits::deallocate(allocator, array, array_capacity);
+    }
+    array = nullptr;
+    array_capacity = 0;
+  }
 };
 #endif /* VEC_H */
@@ -0,0 +1,129 @@
+#include "../../headers/histogram.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+  measures how fast every histogram kernel counts a couple of different kinds
+  of data, the plain single table loop is there to compare against
+
+  usage: tira_histogram_bench [size in MB, default 64]
+*/
+
+struct corpus {
+  const char *name;
+  std::vector<std::uint8_t> data;
+};
+
+static std::vector<corpus> make_corpora(std::size_t size) {
+  std::vector<corpus> corpora;
+  std::mt19937 rng(42);
+
+  std::vector<std::uint8_t> text(size);
+  const std::string words = "the quick brown fox jumps over the lazy dog\n";
+  for (std::size_t i = 0; i < size; i++) {
+    text[i] = words[(i + rng() % 3) % words.size()];
+  }
+  corpora.push_back({"text", text});
+
+  std::vector<std::uint8_t> random(size);
+  for (std::uint8_t &byte : random) {
+    byte = rng();
+  }
+  corpora.push_back({"random", random});
+
+  /* what `yes` writes */
+  std::vector<std::uint8_t> yes(size);
+  for (std::size_t i = 0; i < size; i++) {
+    yes[i] = i % 2 ? '\n' : 'y';
+  }
+  corpora.push_back({"yes", yes});
+
+  std::vector<std::uint8_t> runs(size);
+  for (std::size_t i = 0; i < size;) {
+    std::size_t run = std::min<std::size_t>(size - i, 1 + rng() % 4096);
+    std::fill(runs.begin() + i, runs.begin() + i + run, (std::uint8_t)rng());
+    i += run;
+  }
+  corpora.push_back({"runs", runs});
+
+  std::vector<std::uint8_t> zeros(size, 0);
+  corpora.push_back({"zeros", zeros});
+  return corpora;
+}
+
+static void plain(const std::uint8_t *data, std::size_t size,
+                  std::uint64_t (&frequencies)[UCHAR_MAX + 1]) {
+  for (std::size_t i = 0; i < size; i++) {
+    frequencies[data[i]]++;
+  }
+}
+
+/**
+ * @brief the best MB/s out of a couple of runs
+ */
+template <typename F>
+static double measure(const corpus &c, std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                      F &&count) {
+  double best = 0;
+  for (int run = 0; run < 5; run++) {
+    std::fill(frequencies, frequencies + UCHAR_MAX + 1, 0);
+    const auto start = std::chrono::steady_clock::now();
+    count(c.data.data(), c.data.size(), frequencies);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::max(best, c.data.size() / elapsed.count() / (1 << 20));
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  const std::size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 64;
+  const std::vector<corpus> corpora = make_corpora(megabytes << 20);
+  const struct {
+    const char *name;
+    histogram_kernel_t kernel;
+  } kernels[] = {
+      {"scalar", HISTOGRAM_SCALAR},
+      {"sse2", HISTOGRAM_SSE2},
+      {"avx2", HISTOGRAM_AVX2},
+  };
+
+  printf("%-8s %10s", "corpus", "plain");
+  for (const auto &kernel : kernels) {
+    printf(" %10s", kernel.name);
+  }
+  printf("   (MB/s)\n");
+
+  int failed = 0;
+  for (const corpus &c : corpora) {
+    std::uint64_t expected[UCHAR_MAX + 1], counted[UCHAR_MAX + 1];
+    printf("%-8s %10.0f", c.name, measure(c, expected, plain));
+    for (const auto &kernel : kernels) {
+      if (!histogram_supported(kernel.kernel)) {
+        printf(" %10s", "-");
+        continue;
+      }
+      const double speed =
+          measure(c, counted, [&](const std::uint8_t *data, std::size_t size,
+                                  std::uint64_t(&frequencies)[UCHAR_MAX + 1]) {
+            histogram(data, size, frequencies, kernel.kernel);
+          });
+      printf(" %10.0f", speed);
+      if (std::memcmp(expected, counted, sizeof(expected)) != 0) {
+        printf("!");
+        failed = 1;
+      }
+    }
+    printf("\n");
+  }
+  if (failed) {
+    printf("! the counts don't match the plain loop\n");
+  }
+  return failed;
+}
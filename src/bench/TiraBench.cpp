@@ -0,0 +1,368 @@
+#include "../../headers/huffman.h"
+#include "../../headers/tira.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <getopt.h>
+#include <iterator>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+  compresses and decompresses a set of corpora through the library and
+  reports the speed, the ratio, the peak memory and the time spent in every
+  stage, as a table or as json with --json. Every corpus runs in a process of
+  its own so the peak memory is only its own, the stages come from the stats
+  timers of the fastest run and are summed over the threads
+
+  usage: tira_bench [--size 1K,1M,64M] [--level n] [--runs n] [--threads n]
+                    [--file path]... [--json]
+*/
+
+/* what a run measures, copied back from the process it ran in */
+struct measurement {
+  std::size_t size = 0;
+  std::size_t compressed = 0;
+  double compress_speed = 0;
+  double decompress_speed = 0;
+  long peak_rss = 0;
+  tira_stats compress_stats;
+  tira_stats decompress_stats;
+  bool ok = true;
+};
+
+struct result {
+  std::string corpus;
+  measurement measured;
+};
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+  return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static std::vector<std::uint8_t> generate(const std::string &name,
+                                          std::size_t size) {
+  std::mt19937 rng(42);
+  std::vector<std::uint8_t> data(size);
+  if (name == "text") {
+    /* words picked with a zipf like distribution, like natural text */
+    const char *words[] = {"the ",   "of ",     "and ",   "to ",    "in ",
+                           "is ",    "that ",   "for ",   "it ",    "with ",
+                           "data ",  "block ",  "code ",  "tree ",  "bits ",
+                           "table ", "stream ", "value ", "error ", "file\n"};
+    std::size_t i = 0;
+    while (i < size) {
+      const double u = std::generate_canonical<double, 32>(rng);
+      const char *word = words[(std::size_t)(20 * u * u * u) % 20];
+      for (; *word != '\0' && i < size; word++) {
+        data[i++] = *word;
+      }
+    }
+  } else if (name == "yes") {
+    for (std::size_t i = 0; i < size; i++) {
+      data[i] = i % 2 ? '\n' : 'y';
+    }
+  } else if (name == "random") {
+    for (std::uint8_t &byte : data) {
+      byte = rng();
+    }
+  } else if (name == "skewed") {
+    /* geometric, byte n is half as likely as byte n - 1 */
+    std::geometric_distribution<int> geometric(0.5);
+    for (std::uint8_t &byte : data) {
+      byte = std::min(geometric(rng), UCHAR_MAX);
+    }
+  } else if (name == "binary") {
+    /* this executable over and over */
+    std::ifstream self("/proc/self/exe", std::ios::binary);
+    std::vector<std::uint8_t> exe((std::istreambuf_iterator<char>(self)),
+                                  std::istreambuf_iterator<char>());
+    for (std::size_t i = 0; i < size && !exe.empty(); i++) {
+      data[i] = exe[i % exe.size()];
+    }
+  }
+  return data;
+}
+
+static measurement run(const std::vector<std::uint8_t> &data,
+                       const huffman_options &options, int runs) {
+  measurement m;
+  m.size = data.size();
+  tira_compressor compressor(options);
+  tira_decompressor decompressor(options.threads);
+  std::vector<std::uint8_t> compressed(
+      tira_compress_bound(data.size(), options));
+  std::vector<std::uint8_t> decompressed(data.size());
+  const double megabytes = data.size() / (double)(1 << 20);
+
+  tira_enable_stats(true);
+  for (int i = 0; i < runs; i++) {
+    tira_reset_stats();
+    auto start = bench_clock::now();
+    if (compressor.compress(data.data(), data.size(), compressed.data(),
+                            compressed.size(), m.compressed) != TIRA_OK) {
+      m.ok = false;
+      return m;
+    }
+    const double compress_speed = megabytes / seconds_since(start);
+    if (compress_speed > m.compress_speed) {
+      m.compress_speed = compress_speed;
+      m.compress_stats = tira_get_stats();
+    }
+
+    tira_reset_stats();
+    start = bench_clock::now();
+    std::size_t written = 0;
+    if (decompressor.decompress(compressed.data(), m.compressed,
+                                decompressed.data(), decompressed.size(),
+                                written) != TIRA_OK) {
+      m.ok = false;
+      return m;
+    }
+    const double decompress_speed = megabytes / seconds_since(start);
+    if (decompress_speed > m.decompress_speed) {
+      m.decompress_speed = decompress_speed;
+      m.decompress_stats = tira_get_stats();
+    }
+  }
+  tira_enable_stats(false);
+  m.ok = decompressed == data;
+  return m;
+}
+
+/**
+ * @brief loads a corpus and runs it in a child process
+ * @details ru_maxrss only ever grows, so in one process every corpus after a
+ * large one would report the large one's peak. The child's peak starts from
+ * what this process has mapped, which stays small as the corpora are only
+ * loaded in the children.
+ */
+static measurement run_in_child(
+    const std::function<std::vector<std::uint8_t>()> &load,
+    const huffman_options &options, int runs) {
+  measurement m;
+  m.ok = false;
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return m;
+  }
+  const pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return m;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    const measurement measured = run(load(), options, runs);
+    const bool sent =
+        write(fds[1], &measured, sizeof(measured)) == sizeof(measured);
+    _exit(sent ? 0 : 1);
+  }
+  close(fds[1]);
+  const bool received = read(fds[0], &m, sizeof(m)) == sizeof(m);
+  close(fds[0]);
+  int status = 0;
+  rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid || !received ||
+      !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    m = {};
+    m.ok = false;
+    return m;
+  }
+  m.peak_rss = usage.ru_maxrss;
+  return m;
+}
+
+static std::size_t parse_size(const char *text) {
+  char *suffix = nullptr;
+  std::size_t size = strtoull(text, &suffix, 10);
+  if (*suffix == 'K' || *suffix == 'k') {
+    size <<= 10;
+  } else if (*suffix == 'M' || *suffix == 'm') {
+    size <<= 20;
+  } else if (*suffix == 'G' || *suffix == 'g') {
+    size <<= 30;
+  }
+  return size;
+}
+
+static std::string size_name(std::size_t size) {
+  const char *suffixes[] = {"", "K", "M", "G"};
+  int suffix = 0;
+  while (suffix < 3 && size >= 1024 && size % 1024 == 0) {
+    size /= 1024;
+    suffix++;
+  }
+  return std::to_string(size) + suffixes[suffix];
+}
+
+/**
+ * @brief `text` as a json string, quotes and backslashes escaped
+ */
+static std::string json_string(const std::string &text) {
+  std::string out = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((unsigned char)c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+/* milliseconds a stage took in the fastest run */
+static double stage_ms(const tira_stats &stats, stat_timer_t timer) {
+  return stats.nanoseconds[timer] / 1e6;
+}
+
+static void print_json(const std::vector<result> &results, int level) {
+  printf("{\n  \"level\": %d,\n  \"results\": [\n", level);
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const measurement &m = results[i].measured;
+    const tira_stats &c = m.compress_stats;
+    printf("    {\"corpus\": %s, \"size\": %zu, \"compressed\": %zu, "
+           "\"ratio\": %.4f, \"compress_mb_s\": %.1f, "
+           "\"decompress_mb_s\": %.1f, \"peak_rss_kb\": %ld, "
+           "\"stages_ms\": {\"histogram\": %.3f, \"lz77\": %.3f, "
+           "\"tree\": %.3f, \"paths\": %.3f, \"encode\": %.3f, "
+           "\"decode\": %.3f}, \"ok\": %s}%s\n",
+           json_string(results[i].corpus).c_str(), m.size, m.compressed,
+           m.size ? (double)m.compressed / m.size : 0, m.compress_speed,
+           m.decompress_speed, m.peak_rss, stage_ms(c, STAT_HISTOGRAM),
+           stage_ms(c, STAT_LZ77), stage_ms(c, STAT_TREE),
+           stage_ms(c, STAT_PATHS), stage_ms(c, STAT_ENCODE),
+           stage_ms(m.decompress_stats, STAT_DECODE), m.ok ? "true" : "false",
+           i + 1 < results.size() ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+static void print_table(const std::vector<result> &results) {
+  printf("%-16s %10s %7s %10s %10s %9s   %s\n", "corpus", "size", "ratio",
+         "comp MB/s", "dec MB/s", "rss KB",
+         "histogram/lz77/tree/paths/encode/decode ms");
+  for (const result &r : results) {
+    const measurement &m = r.measured;
+    const tira_stats &c = m.compress_stats;
+    printf("%-16s %10zu %7.3f %10.1f %10.1f %9ld   "
+           "%.2f/%.2f/%.2f/%.2f/%.2f/%.2f%s\n",
+           r.corpus.c_str(), m.size,
+           m.size ? (double)m.compressed / m.size : 0, m.compress_speed,
+           m.decompress_speed, m.peak_rss, stage_ms(c, STAT_HISTOGRAM),
+           stage_ms(c, STAT_LZ77), stage_ms(c, STAT_TREE),
+           stage_ms(c, STAT_PATHS), stage_ms(c, STAT_ENCODE),
+           stage_ms(m.decompress_stats, STAT_DECODE),
+           m.ok ? "" : "  ! round trip failed");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const option long_options[] = {
+      {"size", required_argument, nullptr, 's'},
+      {"level", required_argument, nullptr, 'l'},
+      {"runs", required_argument, nullptr, 'r'},
+      {"threads", required_argument, nullptr, 'j'},
+      {"file", required_argument, nullptr, 'f'},
+      {"json", no_argument, nullptr, 'J'},
+      {nullptr, 0, nullptr, 0},
+  };
+  std::vector<std::size_t> sizes = {1 << 10, 64 << 10, 1 << 20, 16 << 20};
+  std::vector<std::string> files;
+  int level = 2, runs = 3;
+  unsigned threads = 0;
+  bool json = false;
+  int opt = 0;
+  while ((opt = getopt_long(argc, argv, "s:l:r:j:f:J", long_options,
+                            nullptr)) != -1) {
+    switch (opt) {
+    case 's': {
+      sizes.clear();
+      const std::string list = optarg;
+      for (std::size_t start = 0; start < list.size();) {
+        std::size_t end = list.find(',', start);
+        end = end == std::string::npos ? list.size() : end;
+        sizes.push_back(parse_size(list.substr(start, end - start).c_str()));
+        start = end + 1;
+      }
+      break;
+    }
+    case 'l':
+      level = strtol(optarg, nullptr, 10);
+      break;
+    case 'r':
+      runs = std::max(1l, strtol(optarg, nullptr, 10));
+      break;
+    case 'j':
+      threads = strtoul(optarg, nullptr, 10);
+      break;
+    case 'f':
+      files.push_back(optarg);
+      break;
+    case 'J':
+      json = true;
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [--size 1K,1M,64M] [--level n] [--runs n] "
+              "[--threads n] [--file path]... [--json]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  huffman_options options;
+  huffman_level(level, options);
+  options.threads = threads;
+
+  std::vector<result> results;
+  auto bench = [&](const std::string &name,
+                   const std::function<std::vector<std::uint8_t>()> &load) {
+    results.push_back({name, run_in_child(load, options, runs)});
+    if (!json) {
+      fprintf(stderr, "%s done\n", name.c_str());
+    }
+  };
+  for (const std::string &file : files) {
+    bench(file, [&]() {
+      std::ifstream in(file, std::ios::binary);
+      return std::vector<std::uint8_t>((std::istreambuf_iterator<char>(in)),
+                                       std::istreambuf_iterator<char>());
+    });
+  }
+  if (files.empty()) {
+    for (const char *name : {"text", "yes", "random", "skewed", "binary"}) {
+      for (std::size_t size : sizes) {
+        bench(std::string(name) + "/" + size_name(size),
+              [&]() { return generate(name, size); });
+      }
+    }
+  }
+
+  if (json) {
+    print_json(results, level);
+  } else {
+    print_table(results);
+  }
+  return std::all_of(results.begin(), results.end(),
+                     [](const result &r) { return r.measured.ok; })
+             ? 0
+             : 1;
+}
@@ -0,0 +1,145 @@
+#include "../../headers/bitstring.h"
+#include "../../headers/vec.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+  measures the common operations of vec against std::vector, the time is the
+  best of a couple of runs in nanoseconds per element
+
+  usage: tira_vec_bench [elements in thousands, default 1000]
+*/
+
+/* keeps the compiler from throwing the work away */
+static volatile std::size_t sink;
+
+/**
+ * @brief the best time out of a couple of runs in ns per element
+ */
+template <typename F> static double measure(std::size_t elements, F &&run) {
+  double best = 1e300;
+  for (int i = 0; i < 5; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / elements);
+  }
+  return best;
+}
+
+template <typename V> static double push_ints(std::size_t elements) {
+  return measure(elements, [&] {
+    V vector;
+    for (std::size_t i = 0; i < elements; i++) {
+      vector.push_back((int)i);
+    }
+    sink = vector.size();
+  });
+}
+
+template <typename V> static double emplace_strings(std::size_t elements) {
+  return measure(elements, [&] {
+    V vector;
+    for (std::size_t i = 0; i < elements; i++) {
+      vector.emplace_back(24, 'a' + i % 26);
+    }
+    sink = vector.size();
+  });
+}
+
+template <typename V> static double copy_bytes(std::size_t elements) {
+  V bytes;
+  bytes.resize(elements);
+  return measure(elements, [&] {
+    V copy = bytes;
+    sink = copy.size();
+  });
+}
+
+template <typename V> static double move_strings(std::size_t elements) {
+  V strings;
+  for (std::size_t i = 0; i < 64; i++) {
+    strings.emplace_back(24, 'a');
+  }
+  return measure(elements, [&] {
+    for (std::size_t i = 0; i < elements; i++) {
+      V moved = std::move(strings);
+      strings = std::move(moved);
+    }
+    sink = strings.size();
+  });
+}
+
+/* a buffer that is filled right after growing, like the encoded blocks */
+static double grow_buffer_vec(std::size_t elements) {
+  return measure(elements, [&] {
+    vec<std::uint8_t> buffer;
+    for (std::size_t size = 4096; size <= elements; size += 4096) {
+      buffer.resize_uninitialized(size);
+      buffer[size - 1] = 1;
+    }
+    sink = buffer.size();
+  });
+}
+
+static double grow_buffer_std(std::size_t elements) {
+  return measure(elements, [&] {
+    std::vector<std::uint8_t> buffer;
+    for (std::size_t size = 4096; size <= elements; size += 4096) {
+      buffer.resize(size);
+      buffer[size - 1] = 1;
+    }
+    sink = buffer.size();
+  });
+}
+
+/* what building the paths of a tree does to a bitstring */
+static double bitstring_paths(std::size_t elements) {
+  return measure(elements, [&] {
+    bitstring path;
+    for (std::size_t i = 0; i < elements; i++) {
+      const std::size_t bit = i % 24;
+      path.set_bit(bit);
+      bitstring copy = path;
+      copy.unset_bit(bit);
+      sink = copy.get_bit(bit);
+    }
+  });
+}
+
+int main(int argc, char *argv[]) {
+  const std::size_t elements =
+      (argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000) * 1000;
+  if (elements == 0) {
+    fprintf(stderr, "usage: %s [elements in thousands]\n", argv[0]);
+    return 1;
+  }
+  const struct {
+    const char *name;
+    double vec_ns, std_ns;
+  } results[] = {
+      {"push_back int", push_ints<vec<int>>(elements),
+       push_ints<std::vector<int>>(elements)},
+      {"emplace_back string", emplace_strings<vec<std::string>>(elements),
+       emplace_strings<std::vector<std::string>>(elements)},
+      {"copy bytes", copy_bytes<vec<std::uint8_t>>(elements),
+       copy_bytes<std::vector<std::uint8_t>>(elements)},
+      {"move strings", move_strings<vec<std::string>>(elements),
+       move_strings<std::vector<std::string>>(elements)},
+      {"grow buffer", grow_buffer_vec(elements), grow_buffer_std(elements)},
+  };
+
+  printf("%-20s %12s %12s   (ns per element)\n", "operation", "vec",
+         "std::vector");
+  for (const auto &result : results) {
+    printf("%-20s %12.3f %12.3f\n", result.name, result.vec_ns, result.std_ns);
+  }
+  printf("%-20s %12.3f\n", "bitstring paths", bitstring_paths(elements));
+  return 0;
+}
@@ -1,36 +1,58 @@
 #include "../headers/bitstring.h"
+#include "../headers/log.h"
 
 #ifdef WIN32
 #define __builtin_bswap64 _byteswap_uint64
-#else
-#include <endian.h>
 #endif
 #include <algorithm>
 #include <cassert>
 
-void bitstring::encode(bitstring &to_encode) {
+/**
+ * @returns `word` with the order of its bits reversed
+ */
+static std::uint64_t reverse_word(std::uint64_t word) {
+  word = ((word >> 1) & 0x5555555555555555llu) |
+         ((word & 0x5555555555555555llu) << 1);
+  word = ((word >> 2) & 0x3333333333333333llu) |
+         ((word & 0x3333333333333333llu) << 2);
+  word = ((word >> 4) & 0x0f0f0f0f0f0f0f0fllu) |
+         ((word & 0x0f0f0f0f0f0f0f0fllu) << 4);
+  return __builtin_bswap64(word);
+}
+
+void bitstring::encode(const bitstring &to_encode) {
   assert(to_encode.len > 0);
-  auto encoded_len = to_encode.len;
-  if (encoded_len > bits_left) {
-    bits.push_back(0);
-    bits_left = BITS_PER_ELEMENT;
-  } else {
-      bits_left -= encoded_len;
+  const std::uint64_t start = len;
+  const std::size_t offset = start / BITS_PER_ELEMENT;
+  const std::uint8_t shift = start % BITS_PER_ELEMENT;
+
+  /* whatever is left past `len` would end up in the middle of the string */
+  if (offset < bits.size()) {
+    bits[offset] &= mask(offset);
+  }
+  bits.resize(words(start + to_encode.len));
+  for (std::size_t table = offset + 1; table < bits.size(); table++) {
+    bits[table] = 0;
   }
 
-  auto encoded = to_encode << this->len;
-  *this |= encoded;
-  this->len += to_encode.len;
+  for (std::size_t table = 0; table < words(to_encode.len); table++) {
+    const std::uint64_t encoded = to_encode.word(table) & to_encode.mask(table);
+    bits[offset + table] |= encoded << shift;
+    if (shift != 0 && offset + table + 1 < bits.size()) {
+      bits[offset + table + 1] |= encoded >> (BITS_PER_ELEMENT - shift);
+    }
+  }
+  len = start + to_encode.len;
 }
 
 bitstring &bitstring::operator|=(const bitstring &mask) {
-  if (bits.size() < mask.bits.capacity()) {
-    bits.resize(mask.bits.capacity() + 1);
+  if (bits.size() < mask.bits.size()) {
+    bits.resize(mask.bits.size());
   }
-  for (std::size_t table = 0;
-       table < bits.capacity() && table < mask.bits.capacity(); table++) {
+  for (std::size_t table = 0; table < mask.bits.size(); table++) {
     bits[table] |= mask.bits[table];
   }
+  len = std::max(len, mask.len);
   return *this;
 }
 
@@ -41,10 +63,10 @@ bitstring bitstring::operator|(const bitstring &mask) const {
 }
 
 bitstring &bitstring::operator&=(const bitstring &mask) {
-  for (std::uint8_t table = 0;
-       table < bits.capacity() && table < mask.bits.capacity(); table++) {
-    bits[table] &= mask.bits[table];
+  for (std::size_t table = 0; table < bits.size(); table++) {
+    bits[table] &= mask.word(table);
   }
+  len = std::max(len, mask.len);
   return *this;
 }
 
@@ -67,90 +89,79 @@ bitstring bitstring::operator<<(const int i) const {
 }
 
 bitstring &bitstring::operator<<=(const int i) {
-  int actual_shift = i % BITS_PER_ELEMENT;
-  int offset_table = i / BITS_PER_ELEMENT;
-  if (bits.size() + offset_table >= bits.capacity()) {
-    bits.reserve((bits.size() + offset_table + 1) * 3 / 2);
-  }
-  /* 0 is a special case which we have to handle, you would get a shift underflow
-   * if you didn't do this, i.e. shifting by 64 */
-  if (actual_shift == 0) {
-    for (int i = bits.size(); i >= 0; i--) {
-      bits[i + offset_table] = bits[i];
-    }
-  } else {
-    for (int table = bits.size(); table >= 0; table--) {
-      if (table > 0) {
-        std::uint8_t spared_bits = (bits[table - 1] >> (BITS_PER_ELEMENT - actual_shift));
-        std::uint8_t shifted_bits = (bits[table] << actual_shift);
-        std::uint8_t result = shifted_bits | spared_bits;
-        bits[table + offset_table] = result;
-      } else {
-        std::uint8_t result = bits[table] << actual_shift;
-        bits[table + offset_table] = result;
-      }
+  assert(i >= 0);
+  const std::size_t offset_table = i / BITS_PER_ELEMENT;
+  const std::uint8_t actual_shift = i % BITS_PER_ELEMENT;
+  const std::size_t last = bits.size();
+  /* one more table for the bits shifted out of the last one */
+  bits.resize(last + offset_table + (actual_shift != 0));
+  /* a shift by 64 is undefined, so a whole table shift is a plain move */
+  for (std::size_t table = last; table-- > 0;) {
+    if (actual_shift != 0) {
+      bits[table + offset_table + 1] |=
+          bits[table] >> (BITS_PER_ELEMENT - actual_shift);
     }
+    bits[table + offset_table] = bits[table] << actual_shift;
   }
-
-  if (offset_table > 0) {
-    for (int i = 0; i < offset_table; i++) {
-      bits[i] = 0;
-    }
+  for (std::size_t table = 0; table < offset_table && table < bits.size();
+       table++) {
+    bits[table] = 0;
   }
+  len += i;
   return *this;
 }
 
 bitstring &bitstring::operator>>=(const int i) {
-  throw std::logic_error("not implemented");
+  assert(i >= 0);
+  const std::size_t offset_table = i / BITS_PER_ELEMENT;
+  const std::uint8_t actual_shift = i % BITS_PER_ELEMENT;
+  const std::size_t size =
+      bits.size() > offset_table ? bits.size() - offset_table : 0;
+  for (std::size_t table = 0; table < size; table++) {
+    bits[table] = bits[table + offset_table] >> actual_shift;
+    if (actual_shift != 0) {
+      bits[table] |= word(table + offset_table + 1)
+                     << (BITS_PER_ELEMENT - actual_shift);
+    }
+  }
+  bits.resize(size);
+  len = len > (std::uint64_t)i ? len - i : 0;
+  return *this;
 }
 
 void bitstring::unset_bit(std::size_t i) {
-  if (i >= std::max((std::size_t)BITS_PER_ELEMENT,
-                    BITS_PER_ELEMENT * bits.capacity())) {
-    bits.resize(i / BITS_PER_ELEMENT + 1);
+  const std::size_t table = i / BITS_PER_ELEMENT;
+  if (table >= bits.size()) {
+    bits.resize(table + 1);
   }
-  int table = i / BITS_PER_ELEMENT;
-  int index = i % BITS_PER_ELEMENT;
-  bits[table] &= ~(1 << index);
+  bits[table] &= ~(std::uint64_t(1) << (i % BITS_PER_ELEMENT));
 }
 
 void bitstring::set_bit(std::size_t i) {
-  if (i >= std::max((std::size_t)BITS_PER_ELEMENT,
-                    BITS_PER_ELEMENT * bits.capacity())) {
-    bits.resize(i / BITS_PER_ELEMENT + 1);
+  const std::size_t table = i / BITS_PER_ELEMENT;
+  if (table >= bits.size()) {
+    bits.resize(table + 1);
   }
-  int table = i / BITS_PER_ELEMENT;
-  int index = i % BITS_PER_ELEMENT;
-  bits[table] |= 1 << index;
+  bits[table] |= std::uint64_t(1) << (i % BITS_PER_ELEMENT);
 }
 
-std::uint8_t bitstring::get_bit(std::size_t i) {
-  if (i >= BITS_PER_ELEMENT * bits.capacity()) {
-    return 0;
-  }
-  std::uint8_t table = i / BITS_PER_ELEMENT;
-  std::uint16_t index = i % BITS_PER_ELEMENT;
-  return (bits[table] >> index) & 1;
+std::uint8_t bitstring::get_bit(std::size_t i) const {
+  return (word(i / BITS_PER_ELEMENT) >> (i % BITS_PER_ELEMENT)) & 1;
 }
 
-void bitstring::reserve(const std::size_t size) { bits.reserve(size); }
-
-bitstring &bitstring::operator=(const bitstring &other) {
-  if (this != &other) {
-    bits = other.bits;
-    len = other.len;
-    bits_left = other.bits_left;
-  }
-  return *this;
+void bitstring::reserve(const std::size_t size) {
+  bits.reserve(words((std::uint64_t)size * CHAR_BIT));
 }
 
 bool bitstring::operator==(const bitstring &bs) const {
-  for (std::size_t i = 0; i < bits.capacity() && i < bs.bits.capacity(); i++) {
-    if (bits[i] != bs.bits[i]) {
+  if (len != bs.len) {
+    return false;
+  }
+  for (std::size_t table = 0; table < words(len); table++) {
+    if ((word(table) ^ bs.word(table)) & mask(table)) {
       return false;
     }
   }
-
   return true;
 }
 
@@ -158,72 +169,102 @@ bool bitstring::operator!=(const bitstring &bs) const {
   return !(operator==(bs));
 }
 
-bitstring::bitstring() {
-  bits.push_back(0);
+std::uint64_t bitstring::popcount() const {
+  std::uint64_t count = 0;
+  for (std::size_t table = 0; table < words(len); table++) {
+    count += __builtin_popcountll(word(table) & mask(table));
+  }
+  return count;
 }
 
-/* 256 is because max path is 256 */
-bitstring::bitstring(const std::uint8_t *bytes, const std::size_t len) : bits(256 / BITS_PER_ELEMENT) {
-  for (int i = 0; i < len; i++) {
-    bits.push_back(bytes[i]);
+std::uint64_t bitstring::leading_zeros() const {
+  for (std::size_t table = words(len); table-- > 0;) {
+    const std::uint64_t masked = word(table) & mask(table);
+    if (masked != 0) {
+      /* the highest set bit is at 63 - clz, the count starts from len - 1 */
+      return len - 1 - (table * BITS_PER_ELEMENT + BITS_PER_ELEMENT - 1 -
+                        __builtin_clzll(masked));
+    }
   }
+  return len;
 }
 
-bitstring::bitstring(const std::uint8_t n) : bits(4) { bits.push_back(n); }
+bitstring::bitstring(const std::uint8_t *bytes, const std::size_t len)
+    : bits(words((std::uint64_t)len * CHAR_BIT)), len(len * CHAR_BIT) {
+  for (std::size_t i = 0; i < len; i++) {
+    bits[i / sizeof(std::uint64_t)] |=
+        (std::uint64_t)bytes[i] << (i % sizeof(std::uint64_t) * CHAR_BIT);
+  }
+}
 
-bitstring::bitstring(const std::uint8_t n, const std::uint32_t len) : bits(4) {
+bitstring::bitstring(const std::uint8_t n) : len(CHAR_BIT) { bits.push_back(n); }
+
+bitstring::bitstring(const std::uint8_t n, const std::uint32_t len)
+    : len(len) {
   bits.push_back(n);
-  this->len = len;
 }
 
-bitstring::bitstring(const bitstring &bs)
-    : len(bs.len), bits(bs.bits), bits_left(bs.bits_left) {}
-
 std::ofstream &operator<<(std::ofstream &stream, const bitstring &bs) {
-  std::cout << "table size: " << bs.bits.size() << "\n";
-  auto length = bs.len;
-
-  for (std::size_t table = 0; table < bs.bits.size(); table++) {
-    /* we want the written  */
-    std::uint8_t big_endian = bs.bits[table];
-    const unsigned char *bytes = (const unsigned char *)&big_endian;
-    stream.write((const char*)bytes, sizeof(big_endian));
-    if (length > BITS_PER_ELEMENT) {
-      length -= BITS_PER_ELEMENT;
-    } else {
-      break;
-    }
+  LOG_TRACE("table size: " << bs.bits.size() << "\n");
+  /* at least one byte, like the tree paths */
+  const std::uint64_t bytes =
+      std::max<std::uint64_t>(1, (bs.len + CHAR_BIT - 1) / CHAR_BIT);
+  for (std::uint64_t i = 0; i < bytes; i++) {
+    const std::uint8_t n = bs.byte(i);
+    stream.write((const char *)&n, sizeof(n));
   }
   return stream;
 }
 
 bitstring &bitstring::reverse() {
-  throw std::logic_error("reverse not implemented");
-  vec<std::uint8_t> reversed(bits.size());
-  for (unsigned int i = 0; i < bits.size(); i++) {
-    reversed[bits.size() - i] = __bswap_64(bits[i]);
+  const std::size_t size = words(len);
+  bits.resize(size);
+  for (std::size_t table = 0; table < size / 2; table++) {
+    const std::uint64_t low = bits[table];
+    bits[table] = reverse_word(bits[size - 1 - table]);
+    bits[size - 1 - table] = reverse_word(low);
   }
+  if (size % 2 != 0) {
+    bits[size / 2] = reverse_word(bits[size / 2]);
+  }
+  /* the reversed bits end at the top of the last table, not at len */
+  const std::uint64_t length = len;
+  len = size * BITS_PER_ELEMENT;
+  *this >>= len - length;
   return *this;
 }
 
-void bitstring::write_tree_path(std::ofstream &stream) const {
-  std::cout << "bitstring length: " << len << "\n";
+void bitstring::write_tree_path(std::ostream &stream) const {
+  LOG_TRACE("bitstring length: " << len << "\n");
 
-  for (unsigned int i = 0; i < this->len / BITS_PER_ELEMENT + 1; i++) {
-    auto n = bits[i];
+  for (std::uint64_t i = 0; i < this->len / CHAR_BIT + 1; i++) {
+    const std::uint8_t n = byte(i);
     stream.write((const char *)&n, sizeof(n));
-
   }
 }
 
 std::ostream &operator<<(std::ostream &os, const bitstring &value) {
-  for (int table = value.len / BITS_PER_ELEMENT; table >= 0; table--) {
-    for (int j =
-             std::min(value.len - 1, (std::uint64_t)(BITS_PER_ELEMENT - 1llu));
-         j >= 0; j--) {
-      os << ((value.bits[table] >> j) & 1);
-    }
+  for (std::uint64_t i = value.len; i-- > 0;) {
+    os << +value.get_bit(i);
   }
   os << "\n";
   return os;
 }
+
+void bitwriter::write(const bitstring &bs) {
+  /* the bitwriter takes at most 32 bits at a time */
+  for (std::uint64_t bit = 0; bit < bs.len; bit += 32) {
+    const std::uint8_t len = std::min<std::uint64_t>(bs.len - bit, 32);
+    const std::uint64_t bits = (bs.word(bit / BITS_PER_ELEMENT) >>
+                                (bit % BITS_PER_ELEMENT)) &
+                               ((std::uint64_t(1) << len) - 1);
+    write(bits, len);
+  }
+}
+
+void bitwriter::finish() {
+  const std::uint8_t *bytes = (const std::uint8_t *)&buffer;
+  out.insert(out.end(), bytes, bytes + (count + CHAR_BIT - 1) / CHAR_BIT);
+  buffer = 0;
+  count = 0;
+}
@@ -0,0 +1,226 @@
+#include "../headers/block.h"
+#include "../headers/bytes.h"
+#include "../headers/histogram.h"
+#include "../headers/lz77.h"
+#include "../headers/stats.h"
+#include <algorithm>
+#include <cstring>
+
+bool is_container(const std::uint8_t *data, std::size_t size) {
+  return size >= sizeof(CONTAINER_MAGIC) &&
+         std::memcmp(data, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) == 0;
+}
+
+void write_container_header(const container_header &header,
+                            std::vector<std::uint8_t> &out) {
+  out.insert(out.end(), CONTAINER_MAGIC,
+             CONTAINER_MAGIC + sizeof(CONTAINER_MAGIC));
+  append_value(out, header.version);
+  append_value(out, header.flags);
+  append_value(out, header.block_size);
+  append_value(out, header.original_size);
+  append_value(out, header.block_count);
+}
+
+bool read_container_header(const std::uint8_t *data, std::size_t size,
+                           container_header &header) {
+  if (size < container_header::SIZE || !is_container(data, size)) {
+    return false;
+  }
+  data += sizeof(CONTAINER_MAGIC);
+  header.version = read_value<std::uint8_t>(data);
+  header.flags = read_value<std::uint8_t>(data + 1);
+  header.block_size = read_value<std::uint32_t>(data + 2);
+  header.original_size = read_value<std::uint64_t>(data + 6);
+  header.block_count = read_value<std::uint32_t>(data + 14);
+  return header.version == CONTAINER_VERSION;
+}
+
+bool read_block_header(const std::uint8_t *data, std::size_t size,
+                       block_header &header) {
+  if (size < block_header::SIZE) {
+    return false;
+  }
+  header.method = read_value<std::uint8_t>(data);
+  header.raw_size = read_value<std::uint32_t>(data + 1);
+  header.payload_size = read_value<std::uint32_t>(data + 5);
+  return header.payload_size <= size - block_header::SIZE;
+}
+
+bool check_container_index(const std::uint8_t *data, std::size_t size,
+                           const container_header &header) {
+  if (header.block_size == 0 ||
+      header.original_size / header.block_size +
+              (header.original_size % header.block_size != 0) !=
+          header.block_count ||
+      (size - container_header::SIZE) / sizeof(std::uint64_t) <
+          header.block_count) {
+    return false;
+  }
+  const std::uint8_t *index = data + container_header::SIZE;
+  std::uint64_t expected =
+      container_header::SIZE + header.block_count * sizeof(std::uint64_t);
+  std::uint64_t remaining = header.original_size;
+  for (std::uint32_t i = 0; i < header.block_count; i++) {
+    const std::uint64_t offset =
+        read_value<std::uint64_t>(index + i * sizeof(offset));
+    block_header block;
+    if (offset != expected ||
+        !read_block_header(data + offset, size - offset, block) ||
+        block.raw_size != std::min<std::uint64_t>(header.block_size,
+                                                  remaining)) {
+      return false;
+    }
+    expected += block_header::SIZE + block.payload_size;
+    remaining -= block.raw_size;
+  }
+  return expected == size;
+}
+
+std::uint64_t max_payload_size(std::uint64_t raw_size) {
+  /* lengths, total bits and sync interval, then a sync offset and a code of
+     at most MAX_CODE_LEN_LIMIT bits for each byte */
+  return UCHAR_MAX + 2 + sizeof(std::uint64_t) + sizeof(std::uint32_t) +
+         raw_size * (sizeof(std::uint64_t) + MAX_CODE_LEN_LIMIT / CHAR_BIT) +
+         sizeof(std::uint64_t);
+}
+
+void write_end_block(std::vector<std::uint8_t> &out) {
+  append_value(out, (std::uint8_t)END_BLOCK);
+  append_value(out, (std::uint32_t)0);
+  append_value(out, (std::uint32_t)0);
+}
+
+bool encode_block(const std::uint8_t *data, std::size_t size,
+                  const huffman_options &options,
+                  std::vector<std::uint8_t> &out) {
+  if (size > UINT32_MAX) {
+    return false;
+  }
+  const std::size_t start = out.size();
+  block_header header;
+  header.method = HUFFMAN_BLOCK;
+  header.raw_size = size;
+  stat_add(STAT_BLOCKS, 1);
+
+  std::uint64_t frequencies[UCHAR_MAX + 1] = {0};
+  {
+    stat_scope timer(STAT_HISTOGRAM);
+    histogram(data, size, frequencies);
+  }
+  const int used =
+      std::count_if(frequencies, frequencies + UCHAR_MAX + 1,
+                    [](std::uint64_t freq) { return freq != 0; });
+  huffman_options canonical = options;
+  canonical.canonical = true;
+  path_t paths[UCHAR_MAX + 1];
+  std::uint64_t best_size = size;
+  if (used == 1) {
+    header.method = RLE_BLOCK;
+  } else if (used == 0) {
+    header.method = STORED_BLOCK;
+  } else if (!huffman_paths(frequencies, canonical, paths)) {
+    return false;
+  } else {
+    const std::uint64_t encoded =
+        huffman_encoded_size(frequencies, paths, size, options);
+    if (encoded >= size) {
+      header.method = STORED_BLOCK;
+    } else {
+      best_size = encoded;
+      if (options.interleave && options.sync_interval == 0) {
+        header.method = HUFFMAN4_BLOCK;
+      }
+    }
+  }
+  /* decoding goes byte after byte, so no sync points for order-1 blocks */
+  std::vector<std::uint8_t> context_payload;
+  if (options.context && options.sync_interval == 0 && used > 1) {
+    if (!huffman_encode_context(data, size, options, context_payload)) {
+      return false;
+    }
+    if (context_payload.size() < best_size) {
+      header.method = CONTEXT_BLOCK;
+      best_size = context_payload.size();
+    }
+  }
+  /* the match finder keeps positions in 32 bit signed integers */
+  std::vector<std::uint8_t> lz77_payload;
+  if (options.lz77 && used > 1 && size <= INT32_MAX) {
+    if (!lz77_encode(data, size, options, lz77_payload)) {
+      return false;
+    }
+    if (lz77_payload.size() < best_size) {
+      header.method = LZ77_BLOCK;
+    }
+  }
+  append_value(out, header.method);
+  append_value(out, header.raw_size);
+  append_value(out, header.payload_size);
+
+  switch (header.method) {
+  case RLE_BLOCK:
+    out.push_back(data[0]);
+    break;
+  case STORED_BLOCK:
+    out.insert(out.end(), data, data + size);
+    break;
+  case LZ77_BLOCK:
+    out.insert(out.end(), lz77_payload.begin(), lz77_payload.end());
+    break;
+  case CONTEXT_BLOCK:
+    out.insert(out.end(), context_payload.begin(), context_payload.end());
+    break;
+  case HUFFMAN4_BLOCK:
+    if (!huffman_encode_interleaved(data, size, frequencies, paths, out)) {
+      return false;
+    }
+    break;
+  default:
+    if (!huffman_encode(data, size, frequencies, paths, options, out)) {
+      return false;
+    }
+  }
+  if (out.size() - start - block_header::SIZE > UINT32_MAX) {
+    return false;
+  }
+  header.payload_size = out.size() - start - block_header::SIZE;
+  std::memcpy(out.data() + start + 5, &header.payload_size,
+              sizeof(header.payload_size));
+  return true;
+}
+
+bool decode_block(const block_header &header, const std::uint8_t *payload,
+                  std::uint8_t *out, unsigned threads) {
+  stat_add(STAT_BLOCKS, 1);
+  switch (header.method) {
+  case HUFFMAN_BLOCK:
+    return huffman_decode(payload, header.payload_size, out, header.raw_size,
+                          threads) == header.payload_size;
+  case STORED_BLOCK:
+    if (header.payload_size != header.raw_size) {
+      return false;
+    }
+    if (header.raw_size != 0) {
+      std::memcpy(out, payload, header.raw_size);
+    }
+    return true;
+  case RLE_BLOCK:
+    if (header.payload_size != 1) {
+      return false;
+    }
+    std::memset(out, payload[0], header.raw_size);
+    return true;
+  case HUFFMAN4_BLOCK:
+    return huffman_decode_interleaved(payload, header.payload_size, out,
+                                      header.raw_size) == header.payload_size;
+  case CONTEXT_BLOCK:
+    return huffman_decode_context(payload, header.payload_size, out,
+                                  header.raw_size) == header.payload_size;
+  case LZ77_BLOCK:
+    return lz77_decode(payload, header.payload_size, out, header.raw_size,
+                       threads);
+  default:
+    return false;
+  }
+}
@@ -0,0 +1,282 @@
+#include "../headers/codes.h"
+#include <algorithm>
+#include <iterator>
+
+enum length_format_t : std::uint8_t { RAW_LENGTHS, RUN_LENGTHS };
+
+bool canonical_paths(const std::uint8_t (&lengths)[UCHAR_MAX + 1],
+                     path_t (&paths)[UCHAR_MAX + 1]) {
+  std::uint32_t length_count[CANONICAL_MAX_LEN + 1] = {0};
+  std::uint64_t next_code[CANONICAL_MAX_LEN + 1] = {0};
+
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    if (lengths[byte] > CANONICAL_MAX_LEN) {
+      return false;
+    }
+    length_count[lengths[byte]]++;
+  }
+  length_count[0] = 0;
+
+  /* the first code of each length follows the last code of the previous one */
+  std::uint64_t code = 0;
+  for (int len = 1; len <= CANONICAL_MAX_LEN; len++) {
+    code = (code + length_count[len - 1]) << 1;
+    next_code[len] = code;
+  }
+
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    const std::uint8_t len = lengths[byte];
+    paths[byte] = path_t{};
+    if (len == 0) {
+      continue;
+    }
+    code = next_code[len]++;
+    /* more codes than the length has room for */
+    if (code >> len) {
+      return false;
+    }
+    paths[byte].character = byte;
+    paths[byte].len = len;
+    /* the code is read from its most significant bit, which is the first step */
+    for (std::uint8_t bit = 0; bit < len; bit++) {
+      if ((code >> (len - 1 - bit)) & 1) {
+        paths[byte].path.set_bit(bit);
+      }
+    }
+    paths[byte].path.len = len;
+  }
+  return true;
+}
+
+/**
+ * @brief sorts the symbols by frequency, a byte at a time starting from the
+ * lowest, passes where every frequency has the same byte are skipped
+ * @details stable so equal frequencies stay in symbol order
+ */
+static void radix_sort(std::uint64_t *weights, std::uint8_t *symbols,
+                       std::size_t n) {
+  std::uint64_t weight_buffer[UCHAR_MAX + 1];
+  std::uint8_t symbol_buffer[UCHAR_MAX + 1];
+  for (unsigned shift = 0; shift < 64; shift += CHAR_BIT) {
+    std::size_t offsets[UCHAR_MAX + 1] = {0};
+    for (std::size_t i = 0; i < n; i++) {
+      offsets[(weights[i] >> shift) & UCHAR_MAX]++;
+    }
+    if (offsets[(weights[0] >> shift) & UCHAR_MAX] == n) {
+      continue;
+    }
+    std::size_t position = 0;
+    for (std::size_t &offset : offsets) {
+      std::size_t count = offset;
+      offset = position;
+      position += count;
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      std::size_t &offset = offsets[(weights[i] >> shift) & UCHAR_MAX];
+      weight_buffer[offset] = weights[i];
+      symbol_buffer[offset] = symbols[i];
+      offset++;
+    }
+    std::copy(weight_buffer, weight_buffer + n, weights);
+    std::copy(symbol_buffer, symbol_buffer + n, symbols);
+  }
+}
+
+std::uint8_t huffman_code_lengths(
+    const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+    std::uint8_t (&lengths)[UCHAR_MAX + 1]) {
+  std::uint64_t a[UCHAR_MAX + 1];
+  std::uint8_t symbols[UCHAR_MAX + 1];
+  std::size_t n = 0;
+  std::fill(lengths, lengths + UCHAR_MAX + 1, 0);
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    if (frequencies[byte] != 0) {
+      a[n] = frequencies[byte];
+      symbols[n++] = byte;
+    }
+  }
+  if (n == 0) {
+    return 0;
+  }
+  if (n == 1) {
+    lengths[symbols[0]] = 1;
+    return 1;
+  }
+  radix_sort(a, symbols, n);
+
+  /*
+    first pass, the internal nodes are made in place, a[next] is the weight of
+    the next internal node and a[root] the lightest internal node that hasn't
+    been used, used nodes store the index of their parent instead
+  */
+  std::size_t root = 0, leaf = 2;
+  a[0] += a[1];
+  for (std::size_t next = 1; next < n - 1; next++) {
+    /* the lighter of the next leaf and internal node, twice */
+    if (leaf >= n || a[root] < a[leaf]) {
+      a[next] = a[root];
+      a[root++] = next;
+    } else {
+      a[next] = a[leaf++];
+    }
+    if (leaf >= n || (root < next && a[root] < a[leaf])) {
+      a[next] += a[root];
+      a[root++] = next;
+    } else {
+      a[next] += a[leaf++];
+    }
+  }
+
+  /* second pass, the parent indices become depths of the internal nodes */
+  a[n - 2] = 0;
+  for (std::size_t next = n - 2; next-- > 0;) {
+    a[next] = a[a[next]] + 1;
+  }
+
+  /* third pass, the leaves get the depths from the internal node depths */
+  std::int64_t internal = n - 2;
+  std::size_t next = n;
+  std::uint64_t available = 1, depth = 0;
+  while (available > 0) {
+    std::uint64_t used = 0;
+    while (internal >= 0 && a[internal] == depth) {
+      used++;
+      internal--;
+    }
+    while (available > used) {
+      a[--next] = depth;
+      available--;
+    }
+    available = 2 * used;
+    depth++;
+  }
+
+  /* the heaviest symbols are last and got the shortest codes */
+  std::uint8_t longest = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    lengths[symbols[i]] = a[i];
+    longest = std::max(longest, lengths[symbols[i]]);
+  }
+  return longest;
+}
+
+bool limit_code_lengths(const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                        std::uint8_t max_len,
+                        std::uint8_t (&lengths)[UCHAR_MAX + 1]) {
+  /* a coin, either a symbol or a package of two coins from the level below */
+  struct coin {
+    std::uint64_t weight;
+    std::int16_t symbol;
+  };
+  std::vector<coin> leaves;
+  std::fill(lengths, lengths + UCHAR_MAX + 1, 0);
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    if (frequencies[byte] != 0) {
+      leaves.push_back({frequencies[byte], (std::int16_t)byte});
+    }
+  }
+  const std::size_t n = leaves.size();
+  if (n == 1) {
+    lengths[leaves[0].symbol] = 1;
+    return true;
+  }
+  if (n == 0) {
+    return true;
+  }
+  if (max_len >= 64 || (1llu << max_len) < n) {
+    return false;
+  }
+  auto lighter = [](const coin &a, const coin &b) {
+    return a.weight < b.weight;
+  };
+  std::stable_sort(leaves.begin(), leaves.end(), lighter);
+
+  /* levels[0] is the smallest denomination, every level is sorted */
+  std::vector<std::vector<coin>> levels(max_len);
+  levels[0] = leaves;
+  for (std::uint8_t level = 1; level < max_len; level++) {
+    const std::vector<coin> &below = levels[level - 1];
+    std::vector<coin> packages;
+    for (std::size_t i = 0; i + 1 < below.size(); i += 2) {
+      packages.push_back({below[i].weight + below[i + 1].weight, -1});
+    }
+    std::merge(leaves.begin(), leaves.end(), packages.begin(), packages.end(),
+               std::back_inserter(levels[level]), lighter);
+  }
+
+  /*
+    the picked coins of a level are always a prefix of it since packages are
+    made from the start of the level below, so it's enough to count how many
+    packages were picked to know how much of the level below is picked
+  */
+  std::size_t picked = 2 * n - 2;
+  for (int level = max_len - 1; level >= 0; level--) {
+    std::size_t packages = 0;
+    for (std::size_t i = 0; i < picked; i++) {
+      const coin &c = levels[level][i];
+      if (c.symbol < 0) {
+        packages++;
+      } else {
+        lengths[c.symbol]++;
+      }
+    }
+    picked = 2 * packages;
+  }
+  return true;
+}
+
+void write_code_lengths(const std::uint8_t (&lengths)[UCHAR_MAX + 1],
+                        std::vector<std::uint8_t> &out) {
+  std::vector<std::uint8_t> runs;
+  for (int byte = 0; byte < UCHAR_MAX + 1;) {
+    int run = 1;
+    while (byte + run < UCHAR_MAX + 1 && lengths[byte + run] == lengths[byte]) {
+      run++;
+    }
+    runs.push_back(lengths[byte]);
+    runs.push_back(run - 1);
+    byte += run;
+  }
+
+  if (runs.size() < UCHAR_MAX + 1) {
+    out.push_back(RUN_LENGTHS);
+    out.insert(out.end(), runs.begin(), runs.end());
+  } else {
+    out.push_back(RAW_LENGTHS);
+    out.insert(out.end(), lengths, lengths + UCHAR_MAX + 1);
+  }
+}
+
+std::size_t read_code_lengths(const std::uint8_t *data, std::size_t size,
+                              std::uint8_t (&lengths)[UCHAR_MAX + 1]) {
+  if (size < 1) {
+    return 0;
+  }
+  if (data[0] == RAW_LENGTHS) {
+    if (size < UCHAR_MAX + 2) {
+      return 0;
+    }
+    std::copy(data + 1, data + UCHAR_MAX + 2, lengths);
+    return UCHAR_MAX + 2;
+  }
+  if (data[0] != RUN_LENGTHS) {
+    return 0;
+  }
+
+  std::size_t position = 1;
+  int byte = 0;
+  while (byte < UCHAR_MAX + 1) {
+    if (position + 2 > size) {
+      return 0;
+    }
+    const std::uint8_t len = data[position];
+    const int run = data[position + 1] + 1;
+    position += 2;
+    if (byte + run > UCHAR_MAX + 1) {
+      return 0;
+    }
+    std::fill(lengths + byte, lengths + byte + run, len);
+    byte += run;
+  }
+  return position;
+}
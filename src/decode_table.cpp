@@ -0,0 +1,137 @@
+#include "../headers/decode_table.h"
+#include "../headers/bitstring.h"
+#include <algorithm>
+#include <climits>
+
+bool decode_table::build(const path_t *paths, std::size_t count) {
+  constexpr std::size_t primary_size = 1u << PRIMARY_BITS;
+  std::uint32_t codes[UCHAR_MAX + 1] = {0};
+  std::uint8_t widths[primary_size] = {0};
+  /* every slot decodes a single symbol, pairs are merged in afterwards */
+  std::vector<decode_entry> single(primary_size);
+
+  if (count == 0 || count > UCHAR_MAX + 1) {
+    return false;
+  }
+  min_len = MAX_CODE_LEN;
+  for (std::size_t i = 0; i < count; i++) {
+    const path_t &path = paths[i];
+    if (path.len == 0 || path.len > MAX_CODE_LEN) {
+      return false;
+    }
+    codes[i] = 0;
+    for (std::uint8_t bit = 0; bit < path.len; bit++) {
+      codes[i] |= (std::uint32_t)path.path.get_bit(bit) << bit;
+    }
+    min_len = std::min(min_len, path.len);
+
+    if (path.len <= PRIMARY_BITS) {
+      decode_entry entry = {path.character, path.len, path.len};
+      for (std::uint32_t slot = codes[i]; slot < primary_size;
+           slot += 1u << path.len) {
+        if (single[slot].length != 0) {
+          return false;
+        }
+        single[slot] = entry;
+      }
+    } else {
+      std::uint32_t prefix = codes[i] & (primary_size - 1);
+      widths[prefix] =
+          std::max(widths[prefix], (std::uint8_t)(path.len - PRIMARY_BITS));
+    }
+  }
+
+  /* allocate the second level tables behind the primary one */
+  entries.assign(primary_size, decode_entry{});
+  for (std::uint32_t prefix = 0; prefix < primary_size; prefix++) {
+    if (widths[prefix] == 0) {
+      continue;
+    }
+    if (single[prefix].length != 0 ||
+        entries.size() + (1u << widths[prefix]) > UINT16_MAX + 1u) {
+      return false;
+    }
+    single[prefix] = {(std::uint16_t)entries.size(), widths[prefix], 0};
+    entries.resize(entries.size() + (1u << widths[prefix]));
+  }
+
+  for (std::size_t i = 0; i < count; i++) {
+    const path_t &path = paths[i];
+    if (path.len <= PRIMARY_BITS) {
+      continue;
+    }
+    const decode_entry &link = single[codes[i] & (primary_size - 1)];
+    const std::uint8_t rest = path.len - PRIMARY_BITS;
+    decode_entry entry = {path.character, path.len, path.len};
+    for (std::uint32_t slot = codes[i] >> PRIMARY_BITS;
+         slot < (1u << link.length); slot += 1u << rest) {
+      decode_entry &target = entries[link.value + slot];
+      if (target.length != 0) {
+        return false;
+      }
+      target = entry;
+    }
+  }
+
+  /*
+    if the first symbol leaves enough bits in the slot for a whole second
+    symbol the slot decodes both, the remaining bits are the low bits of the
+    slot shifted down so looking them up in the single symbol table works
+  */
+  for (std::uint32_t slot = 0; slot < primary_size; slot++) {
+    decode_entry entry = single[slot];
+    if (entry.first != 0 && entry.length < PRIMARY_BITS) {
+      const decode_entry &next = single[slot >> entry.length];
+      if (next.first != 0 && next.length <= PRIMARY_BITS - entry.length) {
+        entry.value |= next.value << CHAR_BIT;
+        entry.length += next.length;
+      }
+    }
+    entries[slot] = entry;
+  }
+  return true;
+}
+
+bool decode_table::decode(const std::uint8_t *data, std::size_t data_size,
+                          std::uint64_t total_bits, std::uint8_t *out,
+                          std::size_t out_size, std::size_t &written,
+                          std::uint8_t skip) const {
+  const decode_entry *primary = entries.data();
+  std::uint8_t *const start = out;
+  std::uint8_t *const end = out + out_size;
+  bitreader reader(data, data_size, skip);
+
+  written = 0;
+  while (total_bits > 0) {
+    reader.refill();
+    decode_entry entry = primary[reader.peek(PRIMARY_BITS)];
+    if (entry.first != 0) {
+      if (entry.length <= total_bits && end - out >= 2) {
+        out[0] = entry.value;
+        out[1] = entry.value >> CHAR_BIT;
+        out += 1 + (entry.length != entry.first);
+      } else if (entry.first <= total_bits && out < end) {
+        /* only the first symbol is left in the data or fits in the output */
+        *out++ = entry.value;
+        entry.length = entry.first;
+      } else {
+        return false;
+      }
+    } else {
+      if (entry.length == 0) {
+        return false;
+      }
+      const std::uint64_t index =
+          (reader.peek(PRIMARY_BITS + entry.length) >> PRIMARY_BITS);
+      entry = primary[entry.value + index];
+      if (entry.first == 0 || entry.length > total_bits || out >= end) {
+        return false;
+      }
+      *out++ = entry.value;
+    }
+    reader.consume(entry.length);
+    total_bits -= entry.length;
+  }
+  written = out - start;
+  return true;
+}
@@ -1,21 +1,21 @@
 #include "../headers/heap.h"
+#include <stdexcept>
 
-Node *Heap::pop(void) {
-  Node *node = this->nodes[0];
+std::uint16_t Heap::pop(void) {
+  std::uint16_t node = this->nodes[0];
   this->nodes[0] = this->nodes[this->size - 1];
-  this->nodes[this->size - 1] = nullptr;
   this->size--;
   this->heapify(0);
   return node;
 }
 
-void Heap::insert(Node *node) {
-  if (size > NODES_SIZE) {
+void Heap::insert(std::uint16_t node) {
+  if (size >= (int)NODES_SIZE) {
     throw std::out_of_range("stack overflow, heap size larger than array capacity");
   }
-  std::uint8_t i = this->size++;
+  std::uint16_t i = this->size++;
   this->nodes[i] = node;
-  while (i && *node < *this->nodes[(i - 1) / 2]) {
+  while (i && this->less(i, (i - 1) / 2)) {
     this->swap(i, (i - 1) / 2);
     i = (i - 1) / 2;
   }
@@ -28,14 +28,14 @@ void Heap::heapify(std::uint16_t index) {
   std::uint16_t right = index * 2 + 2;
   do {
     smallest = index;
-    left = index * 2;
-    right = index * 2 + 1;
+    left = index * 2 + 1;
+    right = index * 2 + 2;
 
-    if (left < this->size && *this->nodes[left] < *this->nodes[smallest]) {
+    if (left < this->size && this->less(left, smallest)) {
       smallest = left;
     }
 
-    if (right < this->size && *this->nodes[right] < *this->nodes[smallest]) {
+    if (right < this->size && this->less(right, smallest)) {
       smallest = right;
     }
 
@@ -48,6 +48,6 @@ void Heap::heapify(std::uint16_t index) {
   } while (smallest < this->size);
 }
 
-Node *Heap::peek(void) const {
+std::uint16_t Heap::peek(void) const {
   return this->nodes[0];
 }
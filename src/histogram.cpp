@@ -0,0 +1,180 @@
+#include "../headers/histogram.h"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HISTOGRAM_X86
+#endif
+
+namespace {
+constexpr int TABLES = 8;
+/*
+  the tables are summed into the 64 bit counts after every chunk, a table gets
+  at most a chunk worth of counts so they can't overflow
+*/
+constexpr std::size_t CHUNK = 1u << 30;
+/* smaller inputs are counted straight into the 64 bit counts */
+constexpr std::size_t SMALL = 1u << 12;
+
+using tables_t = std::uint32_t[TABLES][UCHAR_MAX + 1];
+using counts_t = std::uint64_t[UCHAR_MAX + 1];
+
+/**
+ * @brief counts the 8 bytes of a word, each into its own table
+ */
+inline void count_word(tables_t &tables, std::uint64_t word) {
+  tables[0][word & 0xff]++;
+  tables[1][(word >> 8) & 0xff]++;
+  tables[2][(word >> 16) & 0xff]++;
+  tables[3][(word >> 24) & 0xff]++;
+  tables[4][(word >> 32) & 0xff]++;
+  tables[5][(word >> 40) & 0xff]++;
+  tables[6][(word >> 48) & 0xff]++;
+  tables[7][word >> 56]++;
+}
+
+void count_scalar(const std::uint8_t *data, std::size_t size,
+                  tables_t &tables, counts_t &) {
+  std::size_t i = 0;
+  for (; i + 2 * sizeof(std::uint64_t) <= size; i += 2 * sizeof(std::uint64_t)) {
+    std::uint64_t first, second;
+    std::memcpy(&first, data + i, sizeof(first));
+    std::memcpy(&second, data + i + sizeof(first), sizeof(second));
+    count_word(tables, first);
+    count_word(tables, second);
+  }
+  for (; i < size; i++) {
+    tables[i % TABLES][data[i]]++;
+  }
+}
+
+#ifdef HISTOGRAM_X86
+/*
+  a run of one byte would make every increment wait for the previous one, so
+  a vector that is all the same byte only adds to the length of the current
+  run which is counted once it ends
+*/
+__attribute__((target("sse2"))) void
+count_sse2(const std::uint8_t *data, std::size_t size, tables_t &tables,
+           counts_t &frequencies) {
+  std::size_t i = 0, run = 0;
+  std::uint8_t run_byte = 0;
+  for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i)) {
+    const __m128i bytes = _mm_loadu_si128((const __m128i *)(data + i));
+    const __m128i first = _mm_set1_epi8((char)data[i]);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, first)) == 0xffff) {
+      if (data[i] != run_byte) {
+        frequencies[run_byte] += run;
+        run_byte = data[i];
+        run = 0;
+      }
+      run += sizeof(__m128i);
+      continue;
+    }
+    count_word(tables, _mm_cvtsi128_si64(bytes));
+    count_word(tables, _mm_cvtsi128_si64(_mm_unpackhi_epi64(bytes, bytes)));
+  }
+  frequencies[run_byte] += run;
+  for (; i < size; i++) {
+    tables[i % TABLES][data[i]]++;
+  }
+}
+
+__attribute__((target("avx2"))) void
+count_avx2(const std::uint8_t *data, std::size_t size, tables_t &tables,
+           counts_t &frequencies) {
+  std::size_t i = 0, run = 0;
+  std::uint8_t run_byte = 0;
+  for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i)) {
+    const __m256i bytes = _mm256_loadu_si256((const __m256i *)(data + i));
+    const __m256i first = _mm256_set1_epi8((char)data[i]);
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, first)) == -1) {
+      if (data[i] != run_byte) {
+        frequencies[run_byte] += run;
+        run_byte = data[i];
+        run = 0;
+      }
+      run += sizeof(__m256i);
+      continue;
+    }
+    const __m128i low = _mm256_castsi256_si128(bytes);
+    const __m128i high = _mm256_extracti128_si256(bytes, 1);
+    count_word(tables, _mm_cvtsi128_si64(low));
+    count_word(tables, _mm_cvtsi128_si64(_mm_unpackhi_epi64(low, low)));
+    count_word(tables, _mm_cvtsi128_si64(high));
+    count_word(tables, _mm_cvtsi128_si64(_mm_unpackhi_epi64(high, high)));
+  }
+  frequencies[run_byte] += run;
+  for (; i < size; i++) {
+    tables[i % TABLES][data[i]]++;
+  }
+}
+#endif
+
+histogram_kernel_t best_kernel() {
+  if (histogram_supported(HISTOGRAM_AVX2)) {
+    return HISTOGRAM_AVX2;
+  }
+  if (histogram_supported(HISTOGRAM_SSE2)) {
+    return HISTOGRAM_SSE2;
+  }
+  return HISTOGRAM_SCALAR;
+}
+} // namespace
+
+bool histogram_supported(histogram_kernel_t kernel) {
+  switch (kernel) {
+  case HISTOGRAM_AUTO:
+  case HISTOGRAM_SCALAR:
+    return true;
+#ifdef HISTOGRAM_X86
+  case HISTOGRAM_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case HISTOGRAM_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+void histogram(const std::uint8_t *data, std::size_t size,
+               std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+               histogram_kernel_t kernel) {
+  if (size < SMALL) {
+    for (std::size_t i = 0; i < size; i++) {
+      frequencies[data[i]]++;
+    }
+    return;
+  }
+
+  static const histogram_kernel_t best = best_kernel();
+  if (kernel == HISTOGRAM_AUTO) {
+    kernel = best;
+  } else if (!histogram_supported(kernel)) {
+    kernel = HISTOGRAM_SCALAR;
+  }
+  void (*count)(const std::uint8_t *, std::size_t, tables_t &, counts_t &) =
+      count_scalar;
+#ifdef HISTOGRAM_X86
+  if (kernel == HISTOGRAM_SSE2) {
+    count = count_sse2;
+  } else if (kernel == HISTOGRAM_AVX2) {
+    count = count_avx2;
+  }
+#endif
+
+  tables_t tables;
+  for (std::size_t start = 0; start < size; start += CHUNK) {
+    std::memset(tables, 0, sizeof(tables));
+    const std::size_t length = size - start < CHUNK ? size - start : CHUNK;
+    count(data + start, length, tables, frequencies);
+    for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+      std::uint64_t sum = 0;
+      for (int table = 0; table < TABLES; table++) {
+        sum += tables[table][byte];
+      }
+      frequencies[byte] += sum;
+    }
+  }
+}
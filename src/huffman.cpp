@@ -1,48 +1,55 @@
 #include "../headers/huffman.h"
 #include "../headers/bitstring.h"
+#include "../headers/block.h"
+#include "../headers/bytes.h"
+#include "../headers/codes.h"
+#include "../headers/decode_table.h"
+#include "../headers/encode_table.h"
 #include "../headers/heap.h"
+#include "../headers/histogram.h"
+#include "../headers/log.h"
+#include "../headers/mapped_file.h"
+#include "../headers/parallel.h"
+#include "../headers/path.h"
+#include "../headers/stats.h"
+#include "../headers/tira.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <climits>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <initializer_list>
 #include <iostream>
 #include <limits>
+#include <sstream>
 #include <stdlib.h>
 #include <string>
 
-/*
-  needed to keep track of how long it actually is
-  e.g. if the path would be 1 then you'd not know if there's
-  4 0's before it
-*/
-struct path_t {
-  std::uint8_t character = 0;
-  std::uint8_t len = 0;
-  bitstring path = {0};
-
-  friend std::ofstream &operator<<(std::ofstream &stream, const path_t &path) {
-    std::cout << "writing byte: 0x" << std::hex << path.character
-              << ", to: " << stream.tellp() << "\n";
-    stream.write((const char *)&path.character, sizeof(character));
-    std::cout << "length: " << +path.len << ", to: " << stream.tellp() << "\n";
-    stream.write((const char *)&path.len, sizeof(len));
-    std::cout << "writing to: " << stream.tellp() << ", path: " << path.path;
-    path.path.write_tree_path(stream);
-    return stream;
-  }
-};
-
 void decompress(std::uint8_t *data, std::size_t data_size,
-                std::uint64_t total_bits, Node *const root);
+                std::uint64_t total_bits, const node_pool &pool,
+                std::uint16_t root, std::vector<std::uint8_t> &output);
+static std::uint16_t build_tree(const path_t *paths, std::uint16_t tree_size,
+                                node_pool &pool);
 namespace fs = std::filesystem;
-static void write_to_file(std::uint8_t *data, std::uint16_t tree_size,
-                          const std::size_t file_size, path_t *paths,
-                          const std::string &filename);
+static_assert(MAX_CODE_LEN_LIMIT <= decode_table::MAX_CODE_LEN,
+              "limited codes have to fit in the decode table");
+static_assert(MAX_CODE_LEN_LIMIT <= encode_table::MAX_CODE_LEN,
+              "limited codes have to fit in the encode table");
+static std::string write_to_file(const std::uint8_t *data,
+                                 std::uint16_t tree_size,
+                                 const std::size_t file_size, path_t *paths,
+                                 const std::uint64_t *frequencies,
+                                 bool canonical);
 
 /**
  * @brief builds the paths for each byte in the tree
  * @details left in the tree will be a 0, right will be a 1
- * @param node a pointer to the node to traverse
+ * @param pool the pool the tree is in
+ * @param node the index of the node to traverse
  * @param paths a reference to an array of paths to store how to traverse the
  * tree for each byte
  * @param path the current path taken
@@ -51,137 +58,1254 @@ static void write_to_file(std::uint8_t *data, std::uint16_t tree_size,
  *
  * NOTE: the paths will be in reverse order, should probably be changed
  */
-static void build_paths(const Node *const node, path_t (&paths)[UCHAR_MAX + 1],
-                        bitstring path, const std::uint8_t index = 0u) {
-  if (node == nullptr) {
+static void build_paths(const node_pool &pool, const std::uint16_t node,
+                        path_t (&paths)[UCHAR_MAX + 1], bitstring path,
+                        const std::uint8_t index = 0u) {
+  if (node == NO_NODE) {
     return;
   }
-  if (node->type == node_type_t::DATA) {
+  const Node &current = pool[node];
+  if (current.type == node_type_t::DATA) {
     std::uint8_t tmp = index > 0 ? index : 1;
-    paths[node->byte] = {node->byte, tmp, path};
-    paths[node->byte].path.len = tmp;
-    std::cout << "found byte: " << node->byte
-              << ", at: " << paths[node->byte].path;
+    paths[current.byte] = {current.byte, tmp, path};
+    paths[current.byte].path.len = tmp;
+    LOG_TRACE("found byte: 0x" << std::hex << +current.byte
+                               << ", at: " << paths[current.byte].path);
     return;
   }
   path.unset_bit(index);
-  build_paths(node->left, paths, path, index + 1);
+  build_paths(pool, current.left, paths, path, index + 1);
   path.set_bit(index);
-  build_paths(node->right, paths, path, index + 1);
+  build_paths(pool, current.right, paths, path, index + 1);
 }
 
-extern void huffman_compression(const std::string &filename) {
-  if (!fs::exists(filename)) {
-    printf("Error: file not found %s\n", filename.c_str());
+extern void huffman_level(int level, huffman_options &options) {
+  /*
+    level 1 keeps the codes short enough that every one is decoded with a
+    single table lookup and interleaves the streams, the high levels use larger
+    blocks so the code lengths are stored less often and also try the order-1
+    tables
+  */
+  static const struct {
+    std::size_t block_size;
+    std::uint8_t max_code_len;
+    bool interleave;
+    bool context;
+    bool lz77;
+    std::uint32_t window;
+    std::uint32_t search_depth;
+  } levels[MAX_LEVEL] = {
+      {256 << 10, 11, true, false, false, 0, 0},
+      {1 << 20, 15, false, false, false, 0, 0},
+      {1 << 20, 15, false, false, true, 16 << 10, 1},
+      {1 << 20, 15, false, false, true, 32 << 10, 4},
+      {1 << 20, 15, false, false, true, 64 << 10, 8},
+      {1 << 20, 15, false, false, true, 64 << 10, 16},
+      {2 << 20, 15, false, true, true, 64 << 10, 32},
+      {4 << 20, 15, false, true, true, 64 << 10, 128},
+      {8 << 20, 24, false, true, true, 64 << 10, 1024},
+  };
+  if (level < MIN_LEVEL || level > MAX_LEVEL) {
     return;
   }
+  const auto &preset = levels[level - 1];
+  options.block_size = preset.block_size;
+  options.max_code_len = preset.max_code_len;
+  options.interleave = preset.interleave;
+  options.context = preset.context;
+  options.lz77 = preset.lz77;
+  if (preset.lz77) {
+    options.window = preset.window;
+    options.search_depth = preset.search_depth;
+  }
+}
 
-  std::uint64_t frequencies[UCHAR_MAX + 1] = {0llu};
-  /*
-   * This *SHOULD* be enough since a tree is at most UCHAR_MAX
-   * high (more like floor(lg(255)) = 7) though since it's not completely
-   * balanced it might be more
-   */
-  path_t paths[UCHAR_MAX + 1];
-  const std::size_t file_size = fs::file_size(filename);
-  std::uint8_t *data = new std::uint8_t[file_size];
-  /* this is to know how many nodes will exist when writing to file */
-  std::uint16_t tree_size = 0;
-  Heap heap;
-
-  /* got tired of trying to implement the c++ way...
-     this was a lot simpler smh */
-  FILE *fp = fopen(filename.c_str(), "rb");
-  fread(data, sizeof(std::uint8_t), file_size, fp);
-  fclose(fp);
-
-  for (std::size_t i = 0; i < file_size; i++) {
-    if (!frequencies[data[i]]) {
-      tree_size++;
+extern bool huffman_paths(const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                          const huffman_options &options,
+                          path_t (&paths)[UCHAR_MAX + 1]) {
+  stat_add(STAT_TREES, 1);
+  stat_scope tree_timer(STAT_TREE);
+  /* canonical codes only need the lengths, so no tree is built for them */
+  if (options.canonical) {
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    const std::uint8_t max_len = huffman_code_lengths(frequencies, lengths);
+    LOG_DEBUG("height: " << +max_len << "\n");
+    if (max_len > options.max_code_len &&
+        !limit_code_lengths(frequencies, options.max_code_len, lengths)) {
+      LOG_INFO("could not limit the codes to " << +options.max_code_len
+                                                << " bits\n");
+      return false;
     }
-    frequencies[data[i]]++;
+    stat_max(STAT_TREE_HEIGHT, std::min(max_len, options.max_code_len));
+    tree_timer.stop();
+    stat_scope paths_timer(STAT_PATHS);
+    return canonical_paths(lengths, paths);
   }
 
+  node_pool pool;
+  Heap heap(pool);
   for (int byte = 0; byte < UCHAR_MAX+1; byte++) {
+    paths[byte] = path_t{};
     if (frequencies[byte] != 0) {
-      Node *node = new Node(byte, frequencies[byte]);
-      heap.insert(node);
+      heap.insert(pool.add(byte, frequencies[byte]));
     }
   }
+  if (heap.get_size() == 0) {
+    return true;
+  }
 
   /* here we will build the tree so we will be able to decode the data later */
-  Node *root = nullptr, *left = nullptr, *right = nullptr;
+  std::uint16_t root = NO_NODE, left = NO_NODE, right = NO_NODE;
   while (heap.get_size() > 1) {
     left = heap.pop();
     right = heap.pop();
-    root = new Node(0, left->freq + right->freq, node_type_t::FILLER);
-    root->left = left;
-    root->right = right;
+    root = pool.add(0, pool[left].freq + pool[right].freq,
+                    node_type_t::FILLER);
+    pool[root].left = left;
+    pool[root].right = right;
     heap.insert(root);
   }
 
   root = heap.peek();
+  tree_timer.stop();
 
+  stat_scope paths_timer(STAT_PATHS);
   bitstring initial_path;
   initial_path.len = 0;
-  build_paths(root, paths, initial_path);
+  build_paths(pool, root, paths, initial_path);
 
-  root->print_tree();
-  std::cout << "height: " << root->height() << "\n";
-  write_to_file(data, tree_size, file_size, paths, filename);
+  if (LOG_ENABLED(LOG_TRACE)) {
+    pool.print_tree(std::cerr, root);
+  }
+  LOG_DEBUG("height: " << pool.tree_height(root) << "\n");
 
-  delete[] data;
+  /* the tree is too deep, the paths are replaced with limited length codes */
+  std::uint8_t max_len = 0;
+  for (const path_t &path : paths) {
+    max_len = std::max(max_len, path.len);
+  }
+  stat_max(STAT_TREE_HEIGHT, std::min(max_len, options.max_code_len));
+  if (max_len > options.max_code_len) {
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    if (!limit_code_lengths(frequencies, options.max_code_len, lengths) ||
+        !canonical_paths(lengths, paths)) {
+      LOG_INFO("could not limit the codes to " << +options.max_code_len
+                                                << " bits\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+extern std::size_t
+huffman_encoded_size(const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                     const path_t (&paths)[UCHAR_MAX + 1], std::size_t size,
+                     const huffman_options &options) {
+  std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+  std::uint64_t total_bits = 0;
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    lengths[byte] = paths[byte].len;
+    total_bits += frequencies[byte] * paths[byte].len;
+  }
+  std::vector<std::uint8_t> header;
+  write_code_lengths(lengths, header);
+  if (options.interleave && options.sync_interval == 0) {
+    /* every stream is padded to a whole byte */
+    return header.size() + HUFFMAN_STREAMS * sizeof(total_bits) +
+           total_bits / CHAR_BIT + HUFFMAN_STREAMS;
+  }
+  const std::uint32_t interval = options.sync_interval;
+  const std::size_t sync_count = interval && size ? (size - 1) / interval : 0;
+  return header.size() + sizeof(total_bits) + sizeof(interval) +
+         sync_count * sizeof(std::uint64_t) +
+         (total_bits + CHAR_BIT - 1) / CHAR_BIT;
+}
+
+extern bool huffman_encode(const std::uint8_t *data, std::size_t size,
+                           const huffman_options &options,
+                           std::vector<std::uint8_t> &out) {
+  std::uint64_t frequencies[UCHAR_MAX + 1] = {0llu};
+  {
+    stat_scope timer(STAT_HISTOGRAM);
+    histogram(data, size, frequencies);
+  }
+
+  huffman_options canonical = options;
+  canonical.canonical = true;
+  path_t paths[UCHAR_MAX + 1];
+  if (!huffman_paths(frequencies, canonical, paths)) {
+    return false;
+  }
+  return huffman_encode(data, size, frequencies, paths, options, out);
+}
+
+extern bool huffman_encode(const std::uint8_t *data, std::size_t size,
+                           const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+                           const path_t (&paths)[UCHAR_MAX + 1],
+                           const huffman_options &options,
+                           std::vector<std::uint8_t> &out) {
+  std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+  std::uint64_t total_bits = 0;
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    lengths[byte] = paths[byte].len;
+    total_bits += frequencies[byte] * paths[byte].len;
+  }
+  stat_scope timer(STAT_ENCODE);
+  stat_add(STAT_SYMBOLS, size);
+  write_code_lengths(lengths, out);
+  append_value(out, total_bits);
+
+  /* the sync points are filled in once the data has been encoded */
+  const std::uint32_t interval = options.sync_interval;
+  const std::size_t sync_count = interval && size ? (size - 1) / interval : 0;
+  append_value(out, interval);
+  const std::size_t sync_start = out.size();
+  out.resize(out.size() + sync_count * sizeof(std::uint64_t));
+
+  out.reserve(out.size() + total_bits / CHAR_BIT + sizeof(std::uint64_t));
+  const encode_table table(paths);
+  bitwriter writer(out);
+  const std::size_t piece = interval ? interval : size;
+  for (std::size_t start = 0, sync = 0; start < size; start += piece) {
+    if (start != 0) {
+      std::uint64_t offset = writer.bits_written();
+      std::memcpy(out.data() + sync_start + sync++ * sizeof(offset), &offset,
+                  sizeof(offset));
+    }
+    const std::size_t end = std::min(size, start + piece);
+    for (std::size_t i = start; i < end; i++) {
+      table.write(writer, data[i]);
+    }
+  }
+  writer.finish();
+  return true;
+}
+
+extern bool huffman_encode_interleaved(
+    const std::uint8_t *data, std::size_t size,
+    const std::uint64_t (&frequencies)[UCHAR_MAX + 1],
+    const path_t (&paths)[UCHAR_MAX + 1], std::vector<std::uint8_t> &out) {
+  std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+  std::uint64_t total_bits = 0;
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    lengths[byte] = paths[byte].len;
+    total_bits += frequencies[byte] * paths[byte].len;
+  }
+  stat_scope timer(STAT_ENCODE);
+  stat_add(STAT_SYMBOLS, size);
+  write_code_lengths(lengths, out);
+
+  const encode_table table(paths);
+  std::vector<std::uint8_t> streams[HUFFMAN_STREAMS];
+  bitwriter writers[HUFFMAN_STREAMS] = {bitwriter(streams[0]),
+                                        bitwriter(streams[1]),
+                                        bitwriter(streams[2]),
+                                        bitwriter(streams[3])};
+  for (std::vector<std::uint8_t> &stream : streams) {
+    stream.reserve(total_bits / CHAR_BIT / HUFFMAN_STREAMS +
+                   sizeof(std::uint64_t));
+  }
+  std::size_t i = 0;
+  for (; i + HUFFMAN_STREAMS <= size; i += HUFFMAN_STREAMS) {
+    table.write(writers[0], data[i]);
+    table.write(writers[1], data[i + 1]);
+    table.write(writers[2], data[i + 2]);
+    table.write(writers[3], data[i + 3]);
+  }
+  for (std::size_t stream = 0; i < size; i++, stream++) {
+    table.write(writers[stream], data[i]);
+  }
+  for (bitwriter &writer : writers) {
+    writer.finish();
+    append_value(out, writer.bits_written());
+  }
+  for (const std::vector<std::uint8_t> &stream : streams) {
+    out.insert(out.end(), stream.begin(), stream.end());
+  }
+  return true;
+}
+
+/**
+ * @brief reads the code lengths and builds the decode table for them
+ * @return the bytes read, 0 if the lengths are corrupt
+ */
+static std::size_t read_decode_table(const std::uint8_t *data,
+                                     std::size_t size, decode_table &table) {
+  stat_scope tree_timer(STAT_TREE);
+  stat_add(STAT_TREES, 1);
+  std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+  path_t canonical_codes[UCHAR_MAX + 1];
+  const std::size_t position = read_code_lengths(data, size, lengths);
+  if (position == 0 || !canonical_paths(lengths, canonical_codes)) {
+    return 0;
+  }
+  path_t paths[UCHAR_MAX + 1];
+  std::size_t count = 0;
+  for (const path_t &path : canonical_codes) {
+    if (path.len != 0) {
+      paths[count++] = path;
+      stat_max(STAT_TREE_HEIGHT, path.len);
+    }
+  }
+  return table.build(paths, count) ? position : 0;
+}
+
+extern std::size_t huffman_decode_interleaved(const std::uint8_t *data,
+                                              std::size_t size,
+                                              std::uint8_t *out,
+                                              std::size_t out_size) {
+  decode_table table;
+  std::size_t position = read_decode_table(data, size, table);
+  if (position == 0 ||
+      size - position < HUFFMAN_STREAMS * sizeof(std::uint64_t)) {
+    return 0;
+  }
+  std::uint64_t stream_bits[HUFFMAN_STREAMS];
+  const std::uint8_t *starts[HUFFMAN_STREAMS];
+  std::size_t stream_sizes[HUFFMAN_STREAMS];
+  std::size_t data_start = position + HUFFMAN_STREAMS * sizeof(std::uint64_t);
+  for (std::size_t stream = 0; stream < HUFFMAN_STREAMS; stream++) {
+    stream_bits[stream] = read_value<std::uint64_t>(data + position);
+    position += sizeof(std::uint64_t);
+    /* a stream can't have more bits than 24 for every byte it decodes */
+    const std::uint64_t symbols = out_size / HUFFMAN_STREAMS +
+                                  (stream < out_size % HUFFMAN_STREAMS);
+    if (stream_bits[stream] > symbols * decode_table::MAX_CODE_LEN) {
+      return 0;
+    }
+    stream_sizes[stream] = (stream_bits[stream] + CHAR_BIT - 1) / CHAR_BIT;
+    if (stream_sizes[stream] > size - data_start) {
+      return 0;
+    }
+    starts[stream] = data + data_start;
+    data_start += stream_sizes[stream];
+  }
+
+  stat_scope decode_timer(STAT_DECODE);
+  stat_add(STAT_SYMBOLS, out_size);
+  bitreader readers[HUFFMAN_STREAMS] = {
+      bitreader(starts[0], stream_sizes[0]),
+      bitreader(starts[1], stream_sizes[1]),
+      bitreader(starts[2], stream_sizes[2]),
+      bitreader(starts[3], stream_sizes[3])};
+  std::uint64_t consumed[HUFFMAN_STREAMS] = {0};
+  bool valid = true;
+  auto decode = [&](std::size_t stream, std::size_t i) {
+    std::uint8_t length;
+    out[i] = table.decode_one(readers[stream], length);
+    readers[stream].consume(length);
+    consumed[stream] += length;
+    valid &= length != 0;
+  };
+
+  /* a refill holds two of the longest codes, so two rounds per refill */
+  std::size_t i = 0;
+  for (; i + 2 * HUFFMAN_STREAMS <= out_size; i += 2 * HUFFMAN_STREAMS) {
+    for (bitreader &reader : readers) {
+      reader.refill();
+    }
+    decode(0, i);
+    decode(1, i + 1);
+    decode(2, i + 2);
+    decode(3, i + 3);
+    decode(0, i + 4);
+    decode(1, i + 5);
+    decode(2, i + 6);
+    decode(3, i + 7);
+  }
+  for (; i < out_size; i++) {
+    readers[i % HUFFMAN_STREAMS].refill();
+    decode(i % HUFFMAN_STREAMS, i);
+  }
+
+  for (std::size_t stream = 0; stream < HUFFMAN_STREAMS; stream++) {
+    valid &= consumed[stream] == stream_bits[stream];
+  }
+  return valid ? data_start : 0;
+}
+
+extern std::size_t huffman_decode(const std::uint8_t *data, std::size_t size,
+                                  std::uint8_t *out, std::size_t out_size,
+                                  unsigned threads) {
+  decode_table table;
+  std::size_t position = read_decode_table(data, size, table);
+  if (position == 0 || size - position < sizeof(std::uint64_t)) {
+    return 0;
+  }
+  const std::uint64_t total_bits = read_value<std::uint64_t>(data + position);
+  position += sizeof(total_bits);
+
+  /* the bit offset where every piece starts, the last one is the end */
+  if (size - position < sizeof(std::uint32_t)) {
+    return 0;
+  }
+  const std::uint32_t interval = read_value<std::uint32_t>(data + position);
+  position += sizeof(interval);
+  const std::size_t sync_count =
+      interval && out_size ? (out_size - 1) / interval : 0;
+  if ((size - position) / sizeof(std::uint64_t) < sync_count) {
+    return 0;
+  }
+  std::vector<std::uint64_t> offsets(sync_count + 2, 0);
+  for (std::size_t i = 0; i < sync_count; i++) {
+    offsets[i + 1] = read_value<std::uint64_t>(data + position);
+    position += sizeof(std::uint64_t);
+  }
+  offsets.back() = total_bits;
+  if (!std::is_sorted(offsets.begin(), offsets.end())) {
+    return 0;
+  }
+
+  const std::size_t data_size = (total_bits + CHAR_BIT - 1) / CHAR_BIT;
+  if (total_bits / CHAR_BIT > size - position || data_size > size - position) {
+    return 0;
+  }
+
+  /* every piece is decoded straight into its own slice of the output */
+  stat_scope decode_timer(STAT_DECODE);
+  stat_add(STAT_SYMBOLS, out_size);
+  const std::uint8_t *bits = data + position;
+  const std::size_t piece = interval ? interval : out_size;
+  std::atomic<bool> failed{false};
+  parallel_for(sync_count + 1, threads, [&](std::size_t i) {
+    const std::uint64_t start = offsets[i];
+    const std::size_t out_start = i * piece;
+    const std::size_t out_length = std::min(piece, out_size - out_start);
+    std::size_t written = 0;
+    if (!table.decode(bits + start / CHAR_BIT, data_size - start / CHAR_BIT,
+                      offsets[i + 1] - start, out + out_start, out_length,
+                      written, start % CHAR_BIT) ||
+        written != out_length) {
+      failed = true;
+    }
+  });
+  return failed ? 0 : position + data_size;
+}
+
+/*
+  roughly what the code lengths of another table cost in the header, two
+  groups of contexts are only kept apart if that saves more bits
+*/
+constexpr double CONTEXT_TABLE_BITS = 64 * CHAR_BIT;
+/*
+  contexts that start out in a group of their own, the less used ones start in
+  one group together, this bounds the work of merging them
+*/
+constexpr std::size_t CONTEXT_START_GROUPS = 64;
+
+/**
+ * @return n log2 n, 0 for 0
+ */
+static double weighted_log(const std::uint64_t n) {
+  return n ? n * std::log2((double)n) : 0;
+}
+
+/**
+ * @brief the histogram of a group of contexts
+ */
+struct context_group {
+  std::uint64_t frequencies[UCHAR_MAX + 1] = {0};
+  std::uint64_t total = 0;
+  /* `weighted_log` of every frequency, so merging only computes the new ones */
+  double logs[UCHAR_MAX + 1] = {0};
+
+  void add(const context_group &other) {
+    for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+      frequencies[byte] += other.frequencies[byte];
+    }
+    total += other.total;
+  }
+
+  void update_logs() {
+    for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+      logs[byte] = weighted_log(frequencies[byte]);
+    }
+  }
+};
+
+/**
+ * @return how many more bits coding both groups with one table costs,
+ * counting what an ideal code for each would take
+ * @details a group of `total` bytes takes `total * log2(total) - sum(f *
+ * log2(f))` bits, only the bytes both groups have change the sum
+ */
+static double merge_cost(const context_group &a, const context_group &b) {
+  double shared = 0;
+  for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+    const std::uint64_t x = a.frequencies[byte], y = b.frequencies[byte];
+    if (x != 0 && y != 0) {
+      shared += weighted_log(x + y) - a.logs[byte] - b.logs[byte];
+    }
+  }
+  return weighted_log(a.total + b.total) - weighted_log(a.total) -
+         weighted_log(b.total) - shared;
+}
+
+/**
+ * @brief groups the contexts with similar histograms so they share a table
+ * @details the most used contexts start as a group of their own and the two
+ * groups that cost the least to merge are merged, until there are at most
+ * `max_groups` and every merge left would cost more than a table header.
+ * This is `O(CONTEXT_START_GROUPS^2 * 256)` and doesn't depend on the size of
+ * the data.
+ * @param counts the histogram of context `c` at `counts[c * 256]`
+ * @param contexts set to the group of every context, 0 for the unused ones
+ * @return the groups, none of them empty
+ */
+static std::vector<context_group>
+group_contexts(const std::vector<std::uint32_t> &counts, std::size_t max_groups,
+               std::uint8_t (&contexts)[UCHAR_MAX + 1]) {
+  std::vector<context_group> histograms(UCHAR_MAX + 1);
+  std::vector<int> used;
+  for (int context = 0; context < UCHAR_MAX + 1; context++) {
+    context_group &histogram = histograms[context];
+    for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+      histogram.frequencies[byte] = counts[context * (UCHAR_MAX + 1) + byte];
+      histogram.total += histogram.frequencies[byte];
+    }
+    if (histogram.total != 0) {
+      used.push_back(context);
+    }
+  }
+  std::stable_sort(used.begin(), used.end(), [&](int a, int b) {
+    return histograms[a].total > histograms[b].total;
+  });
+
+  /* the group of every context while merging, the unused ones have none */
+  int owners[UCHAR_MAX + 1];
+  std::fill(std::begin(owners), std::end(owners), -1);
+  std::vector<context_group> groups(
+      std::min(used.size(), CONTEXT_START_GROUPS));
+  for (std::size_t i = 0; i < used.size(); i++) {
+    const std::size_t group = std::min(i, groups.size() - 1);
+    owners[used[i]] = group;
+    groups[group].add(histograms[used[i]]);
+  }
+  for (context_group &group : groups) {
+    group.update_logs();
+  }
+
+  std::size_t n = groups.size();
+  std::vector<double> costs(n * n, 0);
+  for (std::size_t i = 0; i < n; i++) {
+    for (std::size_t j = i + 1; j < n; j++) {
+      costs[i * n + j] = costs[j * n + i] = merge_cost(groups[i], groups[j]);
+    }
+  }
+  const std::size_t stride = n;
+  while (n > 1) {
+    std::size_t best_i = 0, best_j = 1;
+    for (std::size_t i = 0; i < n; i++) {
+      for (std::size_t j = i + 1; j < n; j++) {
+        if (costs[i * stride + j] < costs[best_i * stride + best_j]) {
+          best_i = i;
+          best_j = j;
+        }
+      }
+    }
+    if (n <= max_groups &&
+        costs[best_i * stride + best_j] >= CONTEXT_TABLE_BITS) {
+      break;
+    }
+
+    /* best_j goes into best_i and the last group takes the place of best_j */
+    context_group &merged = groups[best_i];
+    merged.add(groups[best_j]);
+    merged.update_logs();
+    const std::size_t last = n - 1;
+    for (int &owner : owners) {
+      if (owner == (int)best_j) {
+        owner = best_i;
+      } else if (owner == (int)last) {
+        owner = best_j;
+      }
+    }
+    groups[best_j] = groups[last];
+    for (std::size_t k = 0; k < n; k++) {
+      costs[best_j * stride + k] = costs[last * stride + k];
+      costs[k * stride + best_j] = costs[k * stride + last];
+    }
+    costs[best_j * stride + best_j] = 0;
+    n--;
+    for (std::size_t k = 0; k < n; k++) {
+      if (k != best_i) {
+        costs[best_i * stride + k] = costs[k * stride + best_i] =
+            merge_cost(merged, groups[k]);
+      }
+    }
+  }
+  groups.resize(n);
+  for (int context = 0; context < UCHAR_MAX + 1; context++) {
+    contexts[context] = owners[context] < 0 ? 0 : owners[context];
+  }
+  return groups;
+}
+
+extern bool huffman_encode_context(const std::uint8_t *data, std::size_t size,
+                                   const huffman_options &options,
+                                   std::vector<std::uint8_t> &out) {
+  if (size == 0 || size > UINT32_MAX) {
+    return false;
+  }
+  /* the first byte is in context 0, as if a 0 was before it */
+  std::vector<std::uint32_t> counts((UCHAR_MAX + 1) * (UCHAR_MAX + 1), 0);
+  {
+    stat_scope timer(STAT_HISTOGRAM);
+    std::uint8_t previous = 0;
+    for (std::size_t i = 0; i < size; i++) {
+      counts[previous * (UCHAR_MAX + 1) + data[i]]++;
+      previous = data[i];
+    }
+  }
+
+  stat_scope tree_timer(STAT_TREE);
+  std::uint8_t contexts[UCHAR_MAX + 1];
+  const std::vector<context_group> groups =
+      group_contexts(counts, MAX_CONTEXT_TABLES, contexts);
+
+  out.push_back(groups.size());
+  for (int context = 0; context < UCHAR_MAX + 1; context += 2) {
+    out.push_back(contexts[context] | contexts[context + 1] << 4);
+  }
+  std::vector<encode_table> tables;
+  tables.reserve(groups.size());
+  std::uint64_t total_bits = 0;
+  for (const context_group &group : groups) {
+    stat_add(STAT_TREES, 1);
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    const std::uint8_t max_len =
+        huffman_code_lengths(group.frequencies, lengths);
+    if (max_len > options.max_code_len &&
+        !limit_code_lengths(group.frequencies, options.max_code_len,
+                            lengths)) {
+      return false;
+    }
+    stat_max(STAT_TREE_HEIGHT, std::min(max_len, options.max_code_len));
+    path_t paths[UCHAR_MAX + 1];
+    if (!canonical_paths(lengths, paths)) {
+      return false;
+    }
+    write_code_lengths(lengths, out);
+    tables.emplace_back(paths);
+    for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+      total_bits += group.frequencies[byte] * lengths[byte];
+    }
+  }
+  tree_timer.stop();
+
+  stat_scope timer(STAT_ENCODE);
+  stat_add(STAT_SYMBOLS, size);
+  append_value(out, total_bits);
+  out.reserve(out.size() + total_bits / CHAR_BIT + sizeof(std::uint64_t));
+  bitwriter writer(out);
+  std::uint8_t previous = 0;
+  for (std::size_t i = 0; i < size; i++) {
+    tables[contexts[previous]].write(writer, data[i]);
+    previous = data[i];
+  }
+  writer.finish();
+  assert(writer.bits_written() == total_bits);
+  return true;
+}
+
+extern std::size_t huffman_decode_context(const std::uint8_t *data,
+                                          std::size_t size, std::uint8_t *out,
+                                          std::size_t out_size) {
+  constexpr std::size_t CONTEXTS_SIZE = (UCHAR_MAX + 1) / 2;
+  if (size < 1 + CONTEXTS_SIZE) {
+    return 0;
+  }
+  const std::size_t table_count = data[0];
+  if (table_count == 0 || table_count > MAX_CONTEXT_TABLES) {
+    return 0;
+  }
+  std::uint8_t contexts[UCHAR_MAX + 1];
+  for (std::size_t i = 0; i < CONTEXTS_SIZE; i++) {
+    contexts[2 * i] = data[1 + i] & 0xf;
+    contexts[2 * i + 1] = data[1 + i] >> 4;
+    if (contexts[2 * i] >= table_count || contexts[2 * i + 1] >= table_count) {
+      return 0;
+    }
+  }
+  std::size_t position = 1 + CONTEXTS_SIZE;
+  std::vector<decode_table> tables(table_count);
+  for (decode_table &table : tables) {
+    const std::size_t read =
+        read_decode_table(data + position, size - position, table);
+    if (read == 0) {
+      return 0;
+    }
+    position += read;
+  }
+
+  if (size - position < sizeof(std::uint64_t)) {
+    return 0;
+  }
+  const std::uint64_t total_bits = read_value<std::uint64_t>(data + position);
+  position += sizeof(total_bits);
+  const std::size_t data_size = (total_bits + CHAR_BIT - 1) / CHAR_BIT;
+  if (total_bits > out_size * (std::uint64_t)decode_table::MAX_CODE_LEN ||
+      data_size > size - position) {
+    return 0;
+  }
+
+  stat_scope decode_timer(STAT_DECODE);
+  stat_add(STAT_SYMBOLS, out_size);
+  bitreader reader(data + position, data_size);
+  std::uint64_t consumed = 0;
+  std::uint8_t previous = 0;
+  bool valid = true;
+  for (std::size_t i = 0; i < out_size; i++) {
+    /* a refill holds two of the longest codes */
+    if (i % 2 == 0) {
+      reader.refill();
+    }
+    std::uint8_t length;
+    previous = tables[contexts[previous]].decode_one(reader, length);
+    out[i] = previous;
+    reader.consume(length);
+    consumed += length;
+    valid &= length != 0;
+  }
+  return valid && consumed == total_bits ? position + data_size : 0;
 }
 
 /**
- * @brief writes the data to file in compressed form
+ * @brief writes the data in compressed form
  *
- * @details it will be encoded from the most significant bit first
- * e.g. 0x2 will be encoded as 0x80, if a bit string won't fit it will be
- * encoded into two bytes e.g. if we've already encoded into a byte 0xa8 (1010
- * 1000) and there's 3 bits left and we want to encode 0xb(1011) we'd shift it
- * by 1 so we get 0x5 (0101) and get the mask 0x1 then we do 0xa8 |= 0x5 = 0xad
- * (1010 1101) and then we move on to the next byte. Where we then use the mask
- * to get the left over bits and shift it to the most significant bit and OR it
- * in.
+ * @details the paths are appended least significant bit first through a
+ * `bitwriter`, e.g. if 3 bits have already been written into a byte and the
+ * next path is 1011 the byte becomes xxxx x(011) << 3 and the remaining 1 goes
+ * to the lowest bit of the next byte. The accumulator is only flushed once a
+ * whole 64 bit word is full so every path is appended in constant time.
+ * @return the compressed single stream
  */
-static void write_to_file(std::uint8_t *data, std::uint16_t tree_size,
-                          const std::size_t file_size, path_t *paths,
-                          const std::string &filename) {
-  std::ofstream output(filename + ".huff", std::ios::binary | std::ios::out);
-  std::cout << "writing to: " << output.tellp() << ", tree size: " << +tree_size
-            << "\n";
-  output.write((const char *)&tree_size, sizeof(tree_size));
-  for (int i = 0; i < UCHAR_MAX+1; i++) {
-    if (paths[i].len != 0) {
-      std::cout << "\n";
-      output << paths[i];
-    }
-  }
-  bitstring compressed_data;
-  compressed_data.len = 0;
-  std::cout << "encoding paths\n";
+static std::string write_to_file(const std::uint8_t *data,
+                                 std::uint16_t tree_size,
+                                 const std::size_t file_size, path_t *paths,
+                                 const std::uint64_t *frequencies,
+                                 bool canonical) {
+  std::ostringstream output(std::ios::binary | std::ios::out);
+  LOG_DEBUG("tree size: " << +tree_size << "\n");
+  if (canonical) {
+    std::uint16_t flagged_size = tree_size | CANONICAL_FLAG;
+    output.write((const char *)&flagged_size, sizeof(flagged_size));
+
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    for (int i = 0; i < UCHAR_MAX + 1; i++) {
+      lengths[i] = paths[i].len;
+    }
+    std::vector<std::uint8_t> header;
+    write_code_lengths(lengths, header);
+    output.write((const char *)header.data(), header.size());
+  } else {
+    output.write((const char *)&tree_size, sizeof(tree_size));
+    for (int i = 0; i < UCHAR_MAX+1; i++) {
+      if (paths[i].len != 0) {
+        output << paths[i];
+      }
+    }
+  }
+  /* the exact size is known up front so the buffer never has to grow */
+  std::uint64_t total_bits = 0;
+  for (int i = 0; i < UCHAR_MAX + 1; i++) {
+    total_bits += frequencies[i] * paths[i].len;
+  }
+
+  std::vector<std::uint8_t> compressed_data;
+  compressed_data.reserve(total_bits / CHAR_BIT + sizeof(std::uint64_t));
+  stat_scope encode_timer(STAT_ENCODE);
+  const encode_table table(paths);
+  bitwriter writer(compressed_data);
   for (std::size_t i = 0; i < file_size; i++) {
-    const std::uint8_t byte = data[i];
-    path_t &path = paths[byte];
-    compressed_data.encode(path.path);
-  }
-
-  std::cout << "total bits: 0x" << std::hex << compressed_data.len
-            << ", writing at: 0x" << output.tellp() << "\n";
-  output.write((const char *)&compressed_data.len, sizeof(compressed_data.len));
-  std::cout << "writing data to: 0x" << output.tellp() << "\n";
-  output << compressed_data;
-  output.close();
-  std::cout << std::endl;
+    table.write(writer, data[i]);
+  }
+  writer.finish();
+  encode_timer.stop();
+  stat_add(STAT_SYMBOLS, file_size);
+
+  assert(total_bits == writer.bits_written());
+  LOG_DEBUG("total bits: 0x" << std::hex << total_bits << ", writing at: 0x"
+                             << output.tellp() << "\n");
+  output.write((const char *)&total_bits, sizeof(total_bits));
+  output.write((const char *)compressed_data.data(), compressed_data.size());
+  return output.str();
+}
+
+/**
+ * @brief opens the file to read, "-" is stdin
+ * @return the file or nullptr, stdin doesn't need to be closed
+ */
+static FILE *open_input(const std::string &filename) {
+  if (filename == "-") {
+    return stdin;
+  }
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    std::cerr << "Error could not open " << filename << "\n";
+  }
+  return file;
+}
+
+/**
+ * @brief opens the file to write, "-" is stdout
+ */
+static FILE *open_output(const std::string &filename) {
+  if (filename == "-") {
+    return stdout;
+  }
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    std::cerr << "Error could not open " << filename << "\n";
+  }
+  return file;
+}
+
+static void close_file(FILE *file) {
+  if (file != nullptr && file != stdin && file != stdout) {
+    fclose(file);
+  } else if (file == stdout) {
+    fflush(file);
+  }
+}
+
+/**
+ * @brief removes an output that couldn't be written completely, "-" is left
+ */
+static void remove_output(const std::string &filename) {
+  std::error_code error;
+  if (filename != "-") {
+    fs::remove(filename, error);
+  }
+}
+
+/* fread and fwrite, timed and counted for the stats */
+static std::size_t read_bytes(void *data, std::size_t size, std::size_t count,
+                              FILE *in) {
+  stat_scope timer(STAT_READ);
+  const std::size_t read = fread(data, size, count, in);
+  stat_add(STAT_BYTES_IN, read * size);
+  return read;
+}
+
+static std::size_t write_bytes(const void *data, std::size_t size,
+                               std::size_t count, FILE *out) {
+  stat_scope timer(STAT_WRITE);
+  const std::size_t written = fwrite(data, size, count, out);
+  stat_add(STAT_BYTES_OUT, written * size);
+  return written;
+}
+
+/**
+ * @brief reads everything left in `in`, only the single stream format needs
+ * the whole input in memory
+ */
+static std::vector<std::uint8_t> read_all(FILE *in) {
+  std::vector<std::uint8_t> data;
+  std::size_t read = 0;
+  do {
+    data.resize(read + (1 << 16));
+    read += read_bytes(data.data() + read, sizeof(std::uint8_t), 1 << 16, in);
+  } while (read == data.size());
+  data.resize(read);
+  return data;
+}
+
+/**
+ * @brief compresses `in` into the container format a batch of blocks at a
+ * time
+ * @details a batch is one block per thread, the blocks of a batch are
+ * compressed in parallel and written in order before the next batch is read
+ * so memory use only depends on the block size and the amount of threads.
+ * If the size of the input is known and the output can seek the index is
+ * filled in at the end, otherwise the container is streamed and ends with an
+ * `END_BLOCK`. An output in append mode can't go back to the index either,
+ * every write ends up at the end of the file.
+ * @param size size of the input, `UNKNOWN_SIZE` if it's a pipe
+ * @param mapped the input mapped into memory, the blocks are then compressed
+ * straight from the mapping instead of being read from `in`
+ */
+extern bool huffman_compress_stream(FILE *in, FILE *out,
+                                    const std::uint64_t size,
+                                    const huffman_options &options,
+                                    const mapped_file *mapped) {
+  if (options.block_size == 0 || options.block_size > UINT32_MAX) {
+    return false;
+  }
+  const unsigned threads = thread_count(options.threads);
+  container_header header;
+  header.block_size = options.block_size;
+  /* the container doesn't have to start at the beginning of the output */
+  const long base = ftell(out);
+  const int flags = fcntl(fileno(out), F_GETFL);
+  const bool seekable = base >= 0 && flags != -1 && !(flags & O_APPEND);
+  /* the index has room for UINT32_MAX blocks, more are streamed */
+  const std::uint64_t block_count =
+      size / options.block_size + (size % options.block_size != 0);
+  if (size != UNKNOWN_SIZE && seekable && block_count <= UINT32_MAX) {
+    header.flags = CONTAINER_INDEXED;
+    header.original_size = size;
+    header.block_count = block_count;
+  } else {
+    header.flags = CONTAINER_STREAMED;
+  }
+
+  std::vector<std::uint8_t> head;
+  write_container_header(header, head);
+  std::vector<std::uint64_t> offsets;
+  if (header.flags & CONTAINER_INDEXED) {
+    offsets.reserve(header.block_count);
+    head.resize(head.size() + header.block_count * sizeof(std::uint64_t));
+  }
+  write_bytes(head.data(), sizeof(std::uint8_t), head.size(), out);
+
+  std::vector<std::vector<std::uint8_t>> raw(threads), encoded(threads);
+  std::vector<const std::uint8_t *> blocks(threads);
+  std::vector<std::size_t> block_sizes(threads);
+  std::uint64_t offset = head.size(), total = 0;
+  bool end = false;
+  while (!end) {
+    std::size_t batch = 0;
+    for (; batch < threads && !end; batch++) {
+      std::size_t read = 0;
+      if (mapped != nullptr) {
+        read = std::min<std::uint64_t>(options.block_size,
+                                       mapped->size() - total);
+        blocks[batch] = mapped->data() + total;
+        stat_add(STAT_BYTES_IN, read);
+      } else {
+        raw[batch].resize(options.block_size);
+        read = read_bytes(raw[batch].data(), sizeof(std::uint8_t),
+                          options.block_size, in);
+        blocks[batch] = raw[batch].data();
+      }
+      block_sizes[batch] = read;
+      total += read;
+      end = read < options.block_size;
+      if (read == 0) {
+        break;
+      }
+    }
+
+    std::atomic<bool> failed{false};
+    parallel_for(batch, threads, [&](std::size_t i) {
+      encoded[i].clear();
+      if (!encode_block(blocks[i], block_sizes[i], options, encoded[i])) {
+        failed = true;
+      }
+    });
+    if (failed) {
+      return false;
+    }
+    for (std::size_t i = 0; i < batch; i++) {
+      offsets.push_back(offset);
+      write_bytes(encoded[i].data(), sizeof(std::uint8_t), encoded[i].size(),
+                  out);
+      offset += encoded[i].size();
+    }
+  }
+
+  if (header.flags & CONTAINER_INDEXED) {
+    /* the file changed size while it was read */
+    if (total != header.original_size) {
+      std::cerr << "Error input changed while compressing\n";
+      return false;
+    }
+    fseek(out, base + (long)container_header::SIZE, SEEK_SET);
+    {
+      /* the index was counted with the header, this only fills it in */
+      stat_scope timer(STAT_WRITE);
+      fwrite(offsets.data(), sizeof(std::uint64_t), offsets.size(), out);
+    }
+    fseek(out, 0, SEEK_END);
+  } else {
+    std::vector<std::uint8_t> end_block;
+    write_end_block(end_block);
+    write_bytes(end_block.data(), sizeof(std::uint8_t), end_block.size(), out);
+  }
+  LOG_INFO("compressed " << total << " bytes into " << offset << " bytes in "
+                         << offsets.size() << " blocks\n");
+  return !ferror(out);
 }
 
-extern void huffman_decompress(const std::string &filename) {
-  std::cout << "Opening: " << filename << "\n";
-  if (!fs::exists(filename)) {
-    std::cout << "Error file not found: " << filename << "\n";
+extern void huffman_compression(const std::string &filename,
+                                const huffman_options &options) {
+  LOG_INFO("Compressing: " << filename << "\n");
+  const bool from_stdin = filename == "-";
+  if (!from_stdin && !fs::exists(filename)) {
+    std::cerr << "Error file not found: " << filename << "\n";
+    return;
+  }
+  if (options.block_size > UINT32_MAX) {
+    std::cerr << "Error block size too large: " << options.block_size << "\n";
+    return;
+  }
+
+  std::string output_name = options.output;
+  if (output_name.empty()) {
+    output_name = from_stdin ? "-" : filename + ".huff";
+  }
+  /* regular files are read through a mapping, pipes through `in` */
+  mapped_file mapped;
+  const bool is_mapped = !from_stdin && mapped.open_read(filename);
+  FILE *in = is_mapped ? nullptr : open_input(filename);
+  FILE *out = is_mapped || in ? open_output(output_name) : nullptr;
+  if ((!is_mapped && in == nullptr) || out == nullptr) {
+    close_file(in);
+    return;
+  }
+
+  if (options.block_size != 0) {
+    /* pipes and fifos have no size up front and get a streamed container */
+    std::uint64_t size = is_mapped ? mapped.size() : UNKNOWN_SIZE;
+    std::error_code error;
+    if (!is_mapped && !from_stdin && fs::is_regular_file(filename, error)) {
+      size = fs::file_size(filename, error);
+      if (error) {
+        size = UNKNOWN_SIZE;
+      }
+    }
+    if (!huffman_compress_stream(in, out, size, options,
+                                 is_mapped ? &mapped : nullptr)) {
+      std::cerr << "Error could not compress " << filename << "\n";
+    }
+    close_file(in);
+    close_file(out);
     return;
   }
+
+  std::uint64_t frequencies[UCHAR_MAX + 1] = {0llu};
+  /*
+   * This *SHOULD* be enough since a tree is at most UCHAR_MAX
+   * high (more like floor(lg(255)) = 7) though since it's not completely
+   * balanced it might be more
+   */
+  path_t paths[UCHAR_MAX + 1];
+  /* the single stream needs the whole input at once */
+  std::vector<std::uint8_t> buffer;
+  if (!is_mapped) {
+    buffer = read_all(in);
+  }
+  const std::uint8_t *data = is_mapped ? mapped.data() : buffer.data();
+  const std::size_t data_size = is_mapped ? mapped.size() : buffer.size();
+  if (is_mapped) {
+    stat_add(STAT_BYTES_IN, data_size);
+  }
+  {
+    stat_scope timer(STAT_HISTOGRAM);
+    histogram(data, data_size, frequencies);
+  }
+  /* this is to know how many nodes will exist when writing to file */
+  const std::uint16_t tree_size =
+      std::count_if(frequencies, frequencies + UCHAR_MAX + 1,
+                    [](std::uint64_t freq) { return freq != 0; });
+
+  if (huffman_paths(frequencies, options, paths)) {
+    std::string compressed =
+        write_to_file(data, tree_size, data_size, paths, frequencies,
+                      options.canonical);
+    write_bytes(compressed.data(), sizeof(char), compressed.size(), out);
+  } else {
+    std::cerr << "Error could not compress " << filename << "\n";
+  }
+
+  close_file(in);
+  close_file(out);
+}
+
+/**
+ * @brief decompresses a container a batch of blocks at a time
+ * @details the blocks are read in order so the index isn't needed and the
+ * input can be a pipe, a batch is decoded in parallel and written before the
+ * next one is read
+ * @param head the first `container_header::SIZE` bytes of the input
+ */
+static bool decompress_stream(FILE *in, FILE *out, const std::uint8_t *head,
+                              const huffman_options &options) {
+  container_header header;
+  if (!read_container_header(head, container_header::SIZE, header) ||
+      header.block_size == 0 ||
+      !(header.flags & (CONTAINER_INDEXED | CONTAINER_STREAMED)) ||
+      ((header.flags & CONTAINER_INDEXED) &&
+       (header.original_size + header.block_size - 1) / header.block_size !=
+           header.block_count)) {
+    std::cerr << "Error invalid container header\n";
+    return false;
+  }
+  const bool streamed = header.flags & CONTAINER_STREAMED;
+  if (!streamed) {
+    std::uint8_t skip[sizeof(std::uint64_t)];
+    for (std::uint32_t i = 0; i < header.block_count; i++) {
+      if (read_bytes(skip, sizeof(skip), 1, in) != 1) {
+        return false;
+      }
+    }
+  }
+
+  /* anything larger than this can't be a valid block */
+  const std::uint64_t max_payload = max_payload_size(header.block_size);
+  const unsigned threads = thread_count(options.threads);
+  std::vector<block_header> blocks(threads);
+  std::vector<std::vector<std::uint8_t>> payloads(threads), decoded(threads);
+  std::uint64_t total = 0;
+  std::uint32_t block = 0;
+  bool end = false;
+  while (!end) {
+    std::size_t batch = 0;
+    for (; batch < threads; batch++) {
+      if (!streamed && block == header.block_count) {
+        end = true;
+        break;
+      }
+      std::uint8_t raw[block_header::SIZE];
+      block_header &current = blocks[batch];
+      if (read_bytes(raw, sizeof(raw), 1, in) != 1 ||
+          !read_block_header(raw, block_header::SIZE + max_payload, current)) {
+        return false;
+      }
+      if (current.method == END_BLOCK) {
+        if (!streamed || current.payload_size != 0) {
+          return false;
+        }
+        end = true;
+        break;
+      }
+      const std::uint64_t expected =
+          std::min<std::uint64_t>(header.block_size, header.original_size -
+                                                         (std::uint64_t)block *
+                                                             header.block_size);
+      if (current.raw_size > header.block_size ||
+          (!streamed && current.raw_size != expected)) {
+        return false;
+      }
+      payloads[batch].resize(current.payload_size);
+      if (read_bytes(payloads[batch].data(), sizeof(std::uint8_t),
+                     current.payload_size, in) != current.payload_size) {
+        return false;
+      }
+      block++;
+    }
+
+    /* with fewer blocks than threads the blocks are split at their sync
+       points */
+    const unsigned block_threads =
+        std::max<std::size_t>(1, threads / std::max<std::size_t>(batch, 1));
+    std::atomic<bool> failed{false};
+    parallel_for(batch, threads, [&](std::size_t i) {
+      decoded[i].resize(blocks[i].raw_size);
+      if (!decode_block(blocks[i], payloads[i].data(), decoded[i].data(),
+                        block_threads)) {
+        failed = true;
+      }
+    });
+    if (failed) {
+      return false;
+    }
+    for (std::size_t i = 0; i < batch; i++) {
+      write_bytes(decoded[i].data(), sizeof(std::uint8_t), decoded[i].size(),
+                  out);
+      total += decoded[i].size();
+    }
+  }
+  return (streamed || total == header.original_size) && !ferror(out);
+}
+
+/**
+ * @brief decompresses an indexed container from a mapped file into a mapped
+ * output
+ * @details the output is sized up front from the header and every block is
+ * decoded in parallel straight from the input mapping into its place in the
+ * output mapping
+ */
+static bool decompress_mapped(const mapped_file &input,
+                              const std::string &output_name,
+                              const huffman_options &options) {
+  /* the output is created at the size from the header, so check it first */
+  container_header header;
+  if (!read_container_header(input.data(), input.size(), header) ||
+      !(header.flags & CONTAINER_INDEXED) ||
+      !check_container_index(input.data(), input.size(), header)) {
+    std::cerr << "Error invalid container header\n";
+    return false;
+  }
+
+  tira_status_t status = TIRA_OK;
+  {
+    mapped_file output;
+    if (!output.open_write(output_name, header.original_size)) {
+      std::cerr << "Error could not open " << output_name << "\n";
+      return false;
+    }
+    std::size_t written = 0;
+    tira_decompressor decompressor(options.threads);
+    status = decompressor.decompress(input.data(), input.size(), output.data(),
+                                     output.size(), written);
+  }
+  if (status != TIRA_OK) {
+    std::cerr << "Error " << tira_status_string(status) << "\n";
+    remove_output(output_name);
+    return false;
+  }
+  return true;
+}
+
+extern bool huffman_decompress(const std::string &filename,
+                               const huffman_options &options) {
+  LOG_INFO("Decompressing: " << filename << "\n");
+  if (filename != "-" && !fs::exists(filename)) {
+    std::cerr << "Error file not found: " << filename << "\n";
+    return false;
+  }
+  std::string output_name = options.output;
+  if (output_name.empty()) {
+    output_name = filename == "-" ? "-" : "output";
+  }
+
+  /* an indexed container going to a file is decoded mapping to mapping */
+  mapped_file mapped;
+  if (filename != "-" && output_name != "-" && mapped.open_read(filename)) {
+    container_header header;
+    if (read_container_header(mapped.data(), mapped.size(), header) &&
+        (header.flags & CONTAINER_INDEXED)) {
+      if (!decompress_mapped(mapped, output_name, options)) {
+        std::cerr << "Error could not decode data\n";
+        return false;
+      }
+      return true;
+    }
+  }
+
+  FILE *in = open_input(filename);
+  if (in == nullptr) {
+    return false;
+  }
+
+  std::uint8_t head[container_header::SIZE] = {0};
+  const std::size_t head_size =
+      read_bytes(head, sizeof(std::uint8_t), sizeof(head), in);
+  if (is_container(head, head_size)) {
+    FILE *out = open_output(output_name);
+    bool decoded = out != nullptr;
+    if (decoded && (head_size != sizeof(head) ||
+                    !decompress_stream(in, out, head, options))) {
+      std::cerr << "Error could not decode data\n";
+      decoded = false;
+    }
+    close_file(in);
+    close_file(out);
+    if (out != nullptr && !decoded) {
+      remove_output(output_name);
+    }
+    return decoded;
+  }
+
+  /* the single stream format needs the whole input */
+  std::vector<std::uint8_t> rest = read_all(in);
+  close_file(in);
+  std::string file((const char *)head, head_size);
+  file.append((const char *)rest.data(), rest.size());
+  rest = {};
+  std::istringstream stream(std::move(file), std::ios::binary);
   /*
     the main point of this function is to read the necessary data
     to decompress it, it also builds the tree which it then passes
@@ -191,15 +1315,49 @@ extern void huffman_decompress(const std::string &filename) {
     data validation, to fix this it would probably be worth to place
     a couple of asserts in here
   */
-  std::ifstream stream(filename, std::ios::binary);
   /* unique nodes available */
   std::uint16_t tree_size = 0;
   stream.read((char *)&tree_size, sizeof(tree_size));
-  std::cout << "Tree size: 0x" << std::hex << tree_size << "\n";
+  const bool canonical = tree_size & CANONICAL_FLAG;
+  tree_size &= ~CANONICAL_FLAG;
+  LOG_DEBUG("tree size: " << tree_size << "\n");
+  if (tree_size > UCHAR_MAX + 1) {
+    std::cerr << "Error invalid tree size: " << tree_size << "\n";
+    return false;
+  }
   path_t *paths = new path_t[tree_size];
 
-  for (int i = 0; i < tree_size; i++) {
-    std::cout << "at: " << std::hex << stream.tellg() << "\n";
+  if (canonical) {
+    /* the length header is at most 257 bytes, read that much and seek back */
+    std::uint8_t header[UCHAR_MAX + 2] = {0};
+    const auto header_start = stream.tellg();
+    stream.read((char *)header, sizeof(header));
+    stream.clear();
+
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    path_t canonical_codes[UCHAR_MAX + 1];
+    std::size_t header_size =
+        read_code_lengths(header, stream.gcount(), lengths);
+    std::uint16_t used = std::count_if(lengths, lengths + UCHAR_MAX + 1,
+                                       [](std::uint8_t len) { return len; });
+    if (header_size == 0 || used != tree_size ||
+        !canonical_paths(lengths, canonical_codes)) {
+      std::cerr << "Error invalid code lengths\n";
+      delete[] paths;
+      return false;
+    }
+    stream.seekg(header_start + (std::streamoff)header_size);
+
+    int i = 0;
+    for (const path_t &path : canonical_codes) {
+      if (path.len != 0) {
+        paths[i++] = path;
+      }
+    }
+  }
+
+  for (int i = 0; i < tree_size && !canonical; i++) {
+    LOG_TRACE("at: 0x" << std::hex << stream.tellg() << "\n");
     std::size_t to_read = sizeof(paths[i].character);
     stream.read((char *)&paths[i].character, to_read);
 
@@ -213,66 +1371,124 @@ extern void huffman_decompress(const std::string &filename) {
     bitstring bs(p, to_read); // shit tier code
 
     paths[i].path = bs;
-    std::cout << "Read byte: 0x" << +paths[i].character
-              << ", length: " << +paths[i].len << "\n";
+    LOG_TRACE("read byte: 0x" << std::hex << +paths[i].character << std::dec
+                              << ", length: " << +paths[i].len << "\n");
   }
 
   decltype(bitstring::len) total_bits = 0;
-  std::cout << "reading total bits at: 0x" << std::hex << stream.tellg()
-            << "\n";
   stream.read((char *)&total_bits, sizeof(total_bits));
 
   auto data_start = stream.tellg();
   stream.seekg(0, stream.end);
   std::size_t data_size = stream.tellg() - data_start;
+  /* the output is sized from total_bits, so it can't be more than the data */
+  if (!stream || total_bits > (std::uint64_t)data_size * CHAR_BIT) {
+    std::cerr << "Error corrupt data\n";
+    delete[] paths;
+    return false;
+  }
 
   std::uint8_t *data = new std::uint8_t[data_size];
   stream.seekg(data_start);
 
-  std::cout << "reading data from: 0x" << data_start << "\n";
-  stream.read((char *)data, sizeof(data) * data_size);
+  LOG_DEBUG("reading data from: 0x" << std::hex << data_start << "\n");
+  stream.read((char *)data, data_size);
 
-  std::cout << "total bits: 0x" << total_bits << "\n";
+  LOG_DEBUG("total bits: 0x" << std::hex << total_bits << "\n");
 
-  /*
-    build the tree, slow as shit to make it though...
-    luckily it's not that large...
-    TODO: storing it better might allow it to be faster?
-   */
-  Node *root = new Node(0, 0, node_type_t::FILLER);
+  std::unique_ptr<std::uint8_t[]> output;
+  std::size_t output_size = 0;
+  stat_scope decode_timer(STAT_DECODE);
+  decode_table table;
+  if (table.build(paths, tree_size)) {
+    const std::size_t max_size = table.max_symbols(total_bits);
+    output.reset(new std::uint8_t[max_size]);
+    if (!table.decode(data, data_size, total_bits, output.get(), max_size,
+                      output_size)) {
+      std::cerr << "Error could not decode data\n";
+      delete[] data;
+      delete[] paths;
+      return false;
+    }
+  } else {
+    /* the paths are too long for the table, walk the tree instead */
+    node_pool pool;
+    const std::uint16_t root = build_tree(paths, tree_size, pool);
+    std::vector<std::uint8_t> walked;
+    if (root == NO_NODE) {
+      std::cerr << "Error invalid paths\n";
+      delete[] data;
+      delete[] paths;
+      return false;
+    }
+    decompress(data, data_size, total_bits, pool, root, walked);
+    output_size = walked.size();
+    output.reset(new std::uint8_t[output_size]);
+    std::copy(walked.begin(), walked.end(), output.get());
+  }
+  decode_timer.stop();
+  stat_add(STAT_SYMBOLS, output_size);
+
+  delete[] data;
+  delete[] paths;
+  FILE *out = open_output(output_name);
+  if (out == nullptr) {
+    return false;
+  }
+  write_bytes(output.get(), sizeof(std::uint8_t), output_size, out);
+  close_file(out);
+  return true;
+}
+
+/**
+ * @brief rebuilds the tree from the paths read from the header
+ * @details slow as shit to make it though... luckily it's not that large,
+ * only needed when the paths don't fit in a `decode_table`
+ * @param pool where the nodes are added
+ * @return the index of the root, `NO_NODE` if the paths need more nodes than
+ * a tree of 256 symbols has
+ */
+static std::uint16_t build_tree(const path_t *paths, std::uint16_t tree_size,
+                                node_pool &pool) {
+  const std::uint16_t root = pool.add(0, 0, node_type_t::FILLER);
   for (int i = 0; i < tree_size; i++) {
-    path_t path = paths[i];
-    Node *node = root;
-    std::cout << "Building tree for: 0x" << std::hex << +path.character
-              << ", len: " << +path.len << "\n";
+    const path_t &path = paths[i];
+    std::uint16_t node = root;
+    LOG_TRACE("building tree for: 0x" << std::hex << +path.character
+                                      << std::dec << ", len: " << +path.len
+                                      << "\n");
     std::string p = "";
-    for (std::int16_t len = 0; len < path.len; len++) {
+    for (std::int16_t len = 0; len < path.len && node != NO_NODE; len++) {
       if (path.path.get_bit(len)) {
-        if (node->right == nullptr) {
-          node->right = new Node(0, 0, node_type_t::FILLER);
+        if (pool[node].right == NO_NODE) {
+          const std::uint16_t child = pool.add(0, 0, node_type_t::FILLER);
+          if (child == NO_NODE) {
+            return NO_NODE;
+          }
+          pool[node].right = child;
         }
-        node = node->right;
+        node = pool[node].right;
         p += "1";
       } else {
-        if (node->left == nullptr && node->type != DATA) {
-          node->left = new Node(0, 0, node_type_t::FILLER);
+        if (pool[node].left == NO_NODE && pool[node].type != DATA) {
+          const std::uint16_t child = pool.add(0, 0, node_type_t::FILLER);
+          if (child == NO_NODE) {
+            return NO_NODE;
+          }
+          pool[node].left = child;
         }
-        node = node->left;
+        node = pool[node].left;
         p += "0";
       }
     }
 
-    std::cout << p + "\n\n";
-    node->byte = path.character;
-    node->type = node_type_t::DATA;
+    LOG_TRACE(p << "\n");
+    if (node != NO_NODE) {
+      pool[node].byte = path.character;
+      pool[node].type = node_type_t::DATA;
+    }
   }
-
-  path_t temp_paths[UCHAR_MAX + 1] = {0};
-  decompress(data, data_size, total_bits, root);
-
-  delete[] data;
-  delete[] paths;
-  delete root;
+  return root;
 }
 
 /**
@@ -280,49 +1496,42 @@ extern void huffman_decompress(const std::string &filename) {
  * @param data the data to compress
  * @param data_size the size of the data array
  * @param total_bits the amount of bits in data
- * @param root the root of the tree
+ * @param pool the pool the tree is in
+ * @param root the index of the root of the tree
+ * @param output where the decompressed bytes are appended
  */
 void decompress(std::uint8_t *data, std::size_t data_size,
-                std::uint64_t total_bits, Node *const root) {
-  assert(root != nullptr);
+                std::uint64_t total_bits, const node_pool &pool,
+                std::uint16_t root, std::vector<std::uint8_t> &output) {
+  assert(root != NO_NODE);
   assert(data != nullptr);
 
-  FILE *uncompressed = fopen("output", "wb");
-  Node *copy = root;
-  copy->print_tree();
-  std::size_t data_iterator = 0;
-  std::string p = "";
-
-  /* walk the tree and decompress the file */
-  while (total_bits > 0 && data_iterator < data_size) {
-    std::uint8_t byte = data[data_iterator++];
-    for (std::int16_t index = 0; index < CHAR_BIT && total_bits > 0; index++) {
-      if (byte & (1 << index)) {
-        if (copy != nullptr) {
-          copy = copy->right;
-        }
-      } else {
-        if (copy != nullptr) {
-          copy = copy->left;
-        }
-      }
-      total_bits--;
-
-      if (copy != nullptr) {
-        if (copy->type == node_type_t::DATA) {
-          fwrite(&copy->byte, sizeof copy->byte, 1, uncompressed);
-          copy = root;
-          p = "";
-          /*
-            it's PROBABLY about as fast to write like this as it would be
-            to copy to a buffer and write it all at once, dunno
-          */
-        }
-      } else {
-        std::cerr << "Error could not traverse tree " << p << "\n";
+  std::uint16_t copy = root;
+  if (LOG_ENABLED(LOG_TRACE)) {
+    pool.print_tree(std::cerr, root);
+  }
+  /* a header claiming more bits than there are only decodes what's there */
+  if (total_bits > data_size * CHAR_BIT) {
+    LOG_DEBUG("bits left: " << total_bits - data_size * CHAR_BIT << "\n");
+    total_bits = data_size * CHAR_BIT;
+  }
+  bitreader reader(data, data_size);
+
+  /* walk the tree and decompress the file, a refill lasts for 56 steps */
+  while (total_bits > 0) {
+    reader.refill();
+    const std::uint8_t steps = std::min<std::uint64_t>(total_bits, 56);
+    for (std::uint8_t step = 0; step < steps; step++) {
+      copy = reader.read(1) ? pool[copy].right : pool[copy].left;
+      if (copy == NO_NODE) {
+        std::cerr << "Error could not traverse tree\n";
         return;
       }
+      if (pool[copy].type == node_type_t::DATA) {
+        output.push_back(pool[copy].byte);
+        copy = root;
+      }
     }
+    total_bits -= steps;
   }
-  std::cout << "bits left: " << total_bits << "\n";
 }
@@ -0,0 +1,264 @@
+#include "../headers/lz77.h"
+#include "../headers/block.h"
+#include "../headers/bytes.h"
+#include "../headers/stats.h"
+#include <climits>
+#include <cstring>
+
+namespace {
+constexpr int HASH_BITS = 15;
+constexpr std::int32_t NO_POSITION = -1;
+
+inline std::uint32_t hash(const std::uint8_t *data) {
+  return (read_value<std::uint32_t>(data) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * @brief how many bytes at `a` and `b` are the same, at most `limit`
+ */
+inline std::size_t match_length(const std::uint8_t *a, const std::uint8_t *b,
+                                std::size_t limit) {
+  std::size_t length = 0;
+  while (length + sizeof(std::uint64_t) <= limit) {
+    const std::uint64_t diff = read_value<std::uint64_t>(a + length) ^
+                               read_value<std::uint64_t>(b + length);
+    if (diff != 0) {
+      return length + __builtin_ctzll(diff) / 8;
+    }
+    length += sizeof(std::uint64_t);
+  }
+  while (length < limit && a[length] == b[length]) {
+    length++;
+  }
+  return length;
+}
+
+void append_length(std::vector<std::uint8_t> &out, std::size_t length) {
+  for (; length >= UINT8_MAX; length -= UINT8_MAX) {
+    out.push_back(UINT8_MAX);
+  }
+  out.push_back(length);
+}
+
+/**
+ * @brief reads a length written by `append_length`
+ * @return false if the stream ends in the middle of it
+ */
+bool read_length(const std::vector<std::uint8_t> &in, std::size_t &position,
+                 std::size_t &length) {
+  length = 0;
+  while (position < in.size()) {
+    const std::uint8_t byte = in[position++];
+    length += byte;
+    if (byte != UINT8_MAX) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief decompresses a stream written by `lz77_encode`
+ * @details a stream is only ever entropy coded, so another `LZ77_BLOCK` in
+ * it is corrupt and can't nest
+ * @param limit the longest the stream can be
+ * @return the bytes read or 0 if it's corrupt
+ */
+std::size_t decode_stream(const std::uint8_t *data, std::size_t size,
+                          std::vector<std::uint8_t> &stream, std::size_t limit,
+                          unsigned threads) {
+  block_header header;
+  if (!read_block_header(data, size, header) || header.raw_size > limit) {
+    return 0;
+  }
+  switch (header.method) {
+  case HUFFMAN_BLOCK:
+  case HUFFMAN4_BLOCK:
+  case CONTEXT_BLOCK:
+  case STORED_BLOCK:
+    /* every byte takes at least a bit */
+    if (header.raw_size > (std::uint64_t)header.payload_size * CHAR_BIT) {
+      return 0;
+    }
+    break;
+  case RLE_BLOCK:
+    break;
+  default:
+    return 0;
+  }
+  stream.resize(header.raw_size);
+  if (!decode_block(header, data + block_header::SIZE, stream.data(),
+                    threads)) {
+    return 0;
+  }
+  return block_header::SIZE + header.payload_size;
+}
+} // namespace
+
+void lz77_parse(const std::uint8_t *data, std::size_t size,
+                const huffman_options &options, lz77_streams &streams) {
+  std::uint32_t window = options.window;
+  if (window > LZ77_MAX_WINDOW) {
+    window = LZ77_MAX_WINDOW;
+  }
+  /* a position's chain entry is overwritten once it's out of the window */
+  std::size_t chain_size = 1;
+  while (chain_size < window) {
+    chain_size <<= 1;
+  }
+  std::vector<std::int32_t> head(1 << HASH_BITS, NO_POSITION);
+  std::vector<std::int32_t> chain(chain_size, NO_POSITION);
+  const std::size_t mask = chain_size - 1;
+  auto insert = [&](std::size_t position) {
+    const std::uint32_t h = hash(data + position);
+    chain[position & mask] = head[h];
+    head[h] = position;
+  };
+
+  std::size_t position = 0, literal_start = 0;
+  while (position + LZ77_MIN_MATCH <= size) {
+    std::size_t best_length = 0, best_distance = 0;
+    std::int32_t candidate = head[hash(data + position)];
+    for (std::uint32_t depth = options.search_depth;
+         depth > 0 && candidate != NO_POSITION &&
+         position - candidate <= window;
+         depth--) {
+      /* only a candidate that beats the best so far is compared in full */
+      if (best_length == 0 ||
+          data[candidate + best_length] == data[position + best_length]) {
+        const std::size_t length =
+            match_length(data + candidate, data + position, size - position);
+        if (length > best_length) {
+          best_length = length;
+          best_distance = position - candidate;
+          if (position + length == size) {
+            break;
+          }
+        }
+      }
+      const std::int32_t next = chain[candidate & mask];
+      if (next >= candidate) {
+        break;
+      }
+      candidate = next;
+    }
+    insert(position);
+
+    if (best_length < LZ77_MIN_MATCH) {
+      position++;
+      continue;
+    }
+    append_length(streams.lengths, position - literal_start);
+    streams.literals.insert(streams.literals.end(), data + literal_start,
+                            data + position);
+    append_length(streams.lengths, best_length - LZ77_MIN_MATCH);
+    streams.distance_low.push_back((best_distance - 1) & 0xff);
+    streams.distance_high.push_back((best_distance - 1) >> 8);
+    streams.sequences++;
+
+    const std::size_t end = position + best_length;
+    for (position++; position < end && position + LZ77_MIN_MATCH <= size;
+         position++) {
+      insert(position);
+    }
+    position = literal_start = end;
+  }
+  append_length(streams.lengths, size - literal_start);
+  streams.literals.insert(streams.literals.end(), data + literal_start,
+                          data + size);
+  streams.sequences++;
+}
+
+bool lz77_encode(const std::uint8_t *data, std::size_t size,
+                 const huffman_options &options,
+                 std::vector<std::uint8_t> &out) {
+  lz77_streams streams;
+  {
+    stat_scope timer(STAT_LZ77);
+    lz77_parse(data, size, options, streams);
+  }
+
+  huffman_options stream_options = options;
+  stream_options.lz77 = false;
+  append_value(out, streams.sequences);
+  for (const std::vector<std::uint8_t> *stream :
+       {&streams.literals, &streams.lengths, &streams.distance_low,
+        &streams.distance_high}) {
+    if (!encode_block(stream->data(), stream->size(), stream_options, out)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool lz77_decode(const std::uint8_t *payload, std::size_t payload_size,
+                 std::uint8_t *out, std::size_t size, unsigned threads) {
+  if (payload_size < sizeof(std::uint32_t)) {
+    return false;
+  }
+  const std::uint32_t sequences = read_value<std::uint32_t>(payload);
+  /* every sequence but the last ends in a match of at least LZ77_MIN_MATCH */
+  if (sequences == 0 || sequences - 1 > size / LZ77_MIN_MATCH) {
+    return false;
+  }
+  /*
+    the literals are at most the block, the lengths two bytes a sequence and a
+    byte for every 255 of the block, which is never more than the block and 2
+  */
+  const std::size_t limit = size + 2;
+  std::size_t read = sizeof(std::uint32_t);
+  std::vector<std::uint8_t> literals, lengths, distance_low, distance_high;
+  for (std::vector<std::uint8_t> *stream :
+       {&literals, &lengths, &distance_low, &distance_high}) {
+    const std::size_t stream_size = decode_stream(
+        payload + read, payload_size - read, *stream, limit, threads);
+    if (stream_size == 0) {
+      return false;
+    }
+    read += stream_size;
+  }
+  if (read != payload_size ||
+      distance_low.size() != sequences - 1 ||
+      distance_high.size() != sequences - 1) {
+    return false;
+  }
+
+  std::size_t written = 0, literal = 0, length_position = 0;
+  for (std::uint32_t sequence = 0; sequence < sequences; sequence++) {
+    std::size_t length;
+    if (!read_length(lengths, length_position, length) ||
+        length > literals.size() - literal || length > size - written) {
+      return false;
+    }
+    if (length != 0) {
+      std::memcpy(out + written, literals.data() + literal, length);
+    }
+    literal += length;
+    written += length;
+    if (sequence == sequences - 1) {
+      break;
+    }
+
+    const std::size_t distance =
+        (distance_low[sequence] | distance_high[sequence] << 8) + 1;
+    if (!read_length(lengths, length_position, length) ||
+        size - written < LZ77_MIN_MATCH ||
+        length > size - written - LZ77_MIN_MATCH || distance > written) {
+      return false;
+    }
+    length += LZ77_MIN_MATCH;
+    std::uint8_t *to = out + written;
+    const std::uint8_t *from = to - distance;
+    if (distance >= length) {
+      std::memcpy(to, from, length);
+    } else {
+      /* the match overlaps what it writes, e.g. a run of one byte */
+      for (std::size_t i = 0; i < length; i++) {
+        to[i] = from[i];
+      }
+    }
+    written += length;
+  }
+  return written == size && literal == literals.size() &&
+         length_position == lengths.size();
+}
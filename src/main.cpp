@@ -1,26 +1,184 @@
+#include <cstdlib>
+#include <getopt.h>
 #include <iostream>
 #include <unistd.h>
 
 #include "../headers/heap.h"
 #include "../headers/huffman.h"
+#include "../headers/log.h"
+#include "../headers/lz77.h"
+#include "../headers/stats.h"
+
+/**
+ * @brief reads a size with an optional K or M suffix
+ */
+static unsigned long long parse_size(const char *text) {
+  char *suffix = nullptr;
+  unsigned long long size = strtoull(text, &suffix, 10);
+  if (*suffix == 'K' || *suffix == 'k') {
+    size <<= 10;
+  } else if (*suffix == 'M' || *suffix == 'm') {
+    size <<= 20;
+  }
+  return size;
+}
+
 int main(int argc, char *argv[]) {
   std::string help = std::string("Usage: ") + argv[0] +
-                     "\n-d filename \tdecompression\n-c filename \tcompression\n";
+                     " [options]"
+                     "\n-d filename \tdecompression\n"
+                     "-c filename \tcompression\n"
+                     "\noptions, given before -c or -d:\n"
+                     "-1 ... -9 \tlevel, -1 is the fastest and -9 "
+                     "compresses the most, later options change it further "
+                     "(default -2)\n"
+                     "-C, --canonical \tstore canonical codes, the header "
+                     "only has the code lengths\n"
+                     "--max-code-len n \tlongest code allowed, between " +
+                     std::to_string(MIN_CODE_LEN_LIMIT) + " and " +
+                     std::to_string(MAX_CODE_LEN_LIMIT) + " (default " +
+                     std::to_string(huffman_options{}.max_code_len) + ")\n"
+                     "-I, --interleave \tcode blocks as 4 streams that "
+                     "decode side by side, not with -s\n"
+                     "-x, --context \talso code blocks with a table per "
+                     "previous byte, kept if smaller, needs blocks, not with "
+                     "-s\n"
+                     "-z, --lz77 \treplace repeated strings with matches "
+                     "before the huffman coding, needs blocks\n"
+                     "--window size \thow far back a match can start, " +
+                     std::to_string(LZ77_MIN_WINDOW) + " to 64K (default " +
+                     std::to_string(huffman_options{}.window >> 10) + "K)\n"
+                     "--depth n \tpositions compared per match, 1 to 4096 "
+                     "(default " +
+                     std::to_string(huffman_options{}.search_depth) + ")\n"
+                     "-b size \tblock size, K and M suffixes allowed, 0 writes "
+                     "a single stream (default 1M)\n"
+                     "-j threads \tthreads to use, 0 uses every core "
+                     "(default 0)\n"
+                     "-s symbols \tsymbols between sync points, lets a block "
+                     "be decompressed on many threads (default 0, none)\n"
+                     "-o file \twrite to file, - is stdout\n"
+                     "--stats[=json] \tprint the time spent in every stage "
+                     "and counters to stderr after every -c or -d, as a table "
+                     "or as json\n"
+                     "-v \tlog to stderr, repeat for more (-v info, -vv "
+                     "debug, -vvv trace)\n"
+                     "\na filename of - reads from stdin and writes to "
+                     "stdout\n";
+  const option long_options[] = {
+      {"canonical", no_argument, nullptr, 'C'},
+      {"max-code-len", required_argument, nullptr, 'L'},
+      {"interleave", no_argument, nullptr, 'I'},
+      {"context", no_argument, nullptr, 'x'},
+      {"lz77", no_argument, nullptr, 'z'},
+      {"window", required_argument, nullptr, 'W'},
+      {"depth", required_argument, nullptr, 'D'},
+      {"stats", optional_argument, nullptr, 'S'},
+      {nullptr, 0, nullptr, 0},
+  };
+  huffman_options options;
+  bool stats_json = false;
   int opt = 0;
+  bool failed = false;
   if(argc < 2) {
     std::cerr << help;
   }
-  while ((opt = getopt(argc, argv, "c:d:")) != -1) {
+  while ((opt = getopt_long(argc, argv, "123456789vCIxzb:j:s:o:c:d:",
+                            long_options, nullptr)) != -1) {
     switch (opt) {
-    case 'c':
-      huffman_compression(optarg);
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      huffman_level(opt - '0', options);
+      break;
+    case 'C':
+      options.canonical = true;
+      break;
+    case 'L': {
+      long len = strtol(optarg, nullptr, 10);
+      if (len < MIN_CODE_LEN_LIMIT || len > MAX_CODE_LEN_LIMIT) {
+        std::cerr << "Error invalid code length: " << optarg << "\n" << help;
+        return 1;
+      }
+      options.max_code_len = len;
+      break;
+    }
+    case 'b': {
+      const unsigned long long size = parse_size(optarg);
+      if (size > UINT32_MAX) {
+        std::cerr << "Error invalid block size: " << optarg << "\n" << help;
+        return 1;
+      }
+      options.block_size = size;
+      break;
+    }
+    case 'I':
+      options.interleave = true;
+      break;
+    case 'x':
+      options.context = true;
       break;
+    case 'z':
+      options.lz77 = true;
+      break;
+    case 'W': {
+      const unsigned long long window = parse_size(optarg);
+      if (window < LZ77_MIN_WINDOW || window > LZ77_MAX_WINDOW) {
+        std::cerr << "Error invalid window: " << optarg << "\n" << help;
+        return 1;
+      }
+      options.window = window;
+      break;
+    }
+    case 'D': {
+      long depth = strtol(optarg, nullptr, 10);
+      if (depth < 1 || depth > 4096) {
+        std::cerr << "Error invalid search depth: " << optarg << "\n" << help;
+        return 1;
+      }
+      options.search_depth = depth;
+      break;
+    }
+    case 'j':
+      options.threads = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      options.sync_interval = strtoul(optarg, nullptr, 10);
+      break;
+    case 'S':
+      stats_json = optarg != nullptr && std::string(optarg) == "json";
+      enable_stats(true);
+      break;
+    case 'v':
+      if (log_level < LOG_TRACE) {
+        log_level = (log_level_t)(log_level + 1);
+      }
+      break;
+    case 'o':
+      options.output = optarg;
+      break;
+    case 'c':
     case 'd':
-      huffman_decompress(optarg);
+      reset_stats();
+      if (opt == 'c') {
+        huffman_compression(optarg, options);
+      } else {
+        failed |= !huffman_decompress(optarg, options);
+      }
+      if (stats_enabled()) {
+        const tira_stats stats = get_stats();
+        std::cerr << (stats_json ? stats.json() + "\n" : stats.summary());
+      }
       break;
     default:
       std::cerr << help;
     }
   }
-  return 0;
+  return failed ? 1 : 0;
 }
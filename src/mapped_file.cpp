@@ -0,0 +1,66 @@
+#include "../headers/mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void mapped_file::close() {
+  if (bytes != nullptr) {
+    munmap(bytes, length);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  bytes = nullptr;
+  length = 0;
+  fd = -1;
+}
+
+bool mapped_file::open_read(const std::string &filename) {
+  close();
+  /* opening a fifo would wait for a writer and then drop what it wrote */
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+    return false;
+  }
+  fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    close();
+    return false;
+  }
+  length = info.st_size;
+  /* mmap doesn't take empty mappings */
+  if (length == 0) {
+    return true;
+  }
+  void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close();
+    return false;
+  }
+  bytes = (std::uint8_t *)mapping;
+  /* the blocks are mostly read front to back */
+  madvise(bytes, length, MADV_SEQUENTIAL);
+  return true;
+}
+
+bool mapped_file::open_write(const std::string &filename, std::size_t size) {
+  close();
+  fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, size) != 0) {
+    close();
+    return false;
+  }
+  length = size;
+  if (length == 0) {
+    return true;
+  }
+  void *mapping =
+      mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close();
+    return false;
+  }
+  bytes = (std::uint8_t *)mapping;
+  return true;
+}
@@ -0,0 +1,67 @@
+#include "../headers/stats.h"
+#include <cstdio>
+
+static const char *const timer_names[STAT_TIMERS] = {
+    "read", "histogram", "tree", "paths", "lz77", "encode", "write", "decode",
+};
+
+static const char *const counter_names[STAT_COUNTERS] = {
+    "bytes_in", "bytes_out", "symbols", "blocks", "trees", "tree_height",
+};
+
+void enable_stats(bool enabled) {
+  stats_detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void reset_stats() {
+  for (auto &timer : stats_detail::nanoseconds) {
+    timer.store(0, std::memory_order_relaxed);
+  }
+  for (auto &counter : stats_detail::counters) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+}
+
+tira_stats get_stats() {
+  tira_stats stats;
+  for (int i = 0; i < STAT_TIMERS; i++) {
+    stats.nanoseconds[i] =
+        stats_detail::nanoseconds[i].load(std::memory_order_relaxed);
+  }
+  for (int i = 0; i < STAT_COUNTERS; i++) {
+    stats.counters[i] =
+        stats_detail::counters[i].load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+std::string tira_stats::summary() const {
+  std::string out;
+  char line[64];
+  /* the timers add up over threads, so they can be more than the wall time */
+  for (int i = 0; i < STAT_TIMERS; i++) {
+    snprintf(line, sizeof(line), "%-12s %12.3f ms\n", timer_names[i],
+             nanoseconds[i] / 1e6);
+    out += line;
+  }
+  for (int i = 0; i < STAT_COUNTERS; i++) {
+    snprintf(line, sizeof(line), "%-12s %12llu\n", counter_names[i],
+             (unsigned long long)counters[i]);
+    out += line;
+  }
+  return out;
+}
+
+std::string tira_stats::json() const {
+  std::string out = "{\"timers_ns\": {";
+  for (int i = 0; i < STAT_TIMERS; i++) {
+    out += std::string(i ? ", " : "") + "\"" + timer_names[i] +
+           "\": " + std::to_string(nanoseconds[i]);
+  }
+  out += "}, \"counters\": {";
+  for (int i = 0; i < STAT_COUNTERS; i++) {
+    out += std::string(i ? ", " : "") + "\"" + counter_names[i] +
+           "\": " + std::to_string(counters[i]);
+  }
+  return out + "}}";
+}
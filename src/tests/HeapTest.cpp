@@ -1,70 +1,136 @@
 #include "../../headers/heap.h"
 #include "../../headers/bitstring.h"
+#include "../../headers/codes.h"
+#include "../../headers/decode_table.h"
+#include "../../headers/huffman.h"
 #include "../../headers/vec.h"
+#include <algorithm>
 #include <climits>
+#include <random>
+#include <string>
 
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 TEST_CASE("Heap inserting", "[heap]") {
-  Heap heap;
+  node_pool pool;
+  Heap heap(pool);
   SECTION("inserting one and popping it") {
-    heap.insert(new Node(0, 123));
-    Node *node = heap.pop();
-    REQUIRE(node->freq == 123);
-    delete node;
+    heap.insert(pool.add(0, 123));
+    std::uint16_t node = heap.pop();
+    REQUIRE(pool[node].freq == 123);
     REQUIRE(heap.get_size() == 0);
   }
 
   SECTION("insert two") {
-    Heap heap;
-    heap.insert(new Node(0, 1));
-    heap.insert(new Node(1, 2));
-    Node *n1 = heap.pop();
-    REQUIRE(n1->freq == 1);
-    Node *n2 = heap.pop();
-    REQUIRE(n2->freq == 2);
+    heap.insert(pool.add(0, 1));
+    heap.insert(pool.add(1, 2));
+    std::uint16_t n1 = heap.pop();
+    REQUIRE(pool[n1].freq == 1);
+    std::uint16_t n2 = heap.pop();
+    REQUIRE(pool[n2].freq == 2);
   }
 
   SECTION("inserting after removal") {
-    heap.insert(new Node(0, 3));
-    heap.insert(new Node(1, 2));
-    Node *node = heap.pop();
-    REQUIRE(node->freq == 2);
-    heap.insert(new Node(2, 42));
-    delete node;
+    heap.insert(pool.add(0, 3));
+    heap.insert(pool.add(1, 2));
+    std::uint16_t node = heap.pop();
+    REQUIRE(pool[node].freq == 2);
+    heap.insert(pool.add(2, 42));
     node = heap.pop();
-    REQUIRE(node->freq == 3);
-    delete node;
+    REQUIRE(pool[node].freq == 3);
     node = heap.pop();
-    REQUIRE(node->freq == 42);
-    delete node;
+    REQUIRE(pool[node].freq == 42);
   }
   SECTION("insert many") {
     int n = UCHAR_MAX;
     for (int i = 0; i < n; i++) {
-      heap.insert(new Node(0, 'a' + i));
+      heap.insert(pool.add(0, 'a' + i));
     }
     for (int i = 0; i < n; i++) {
-      Node *node = heap.pop();
-      REQUIRE(node->freq == 'a' + i);
-      delete node;
+      std::uint16_t node = heap.pop();
+      REQUIRE(pool[node].freq == (std::uint64_t)('a' + i));
     }
   }
+  SECTION("insert many in reverse") {
+    int n = UCHAR_MAX;
+    for (int i = n - 1; i >= 0; i--) {
+      heap.insert(pool.add(0, i * 7 % n));
+    }
+    for (int i = 0; i < n; i++) {
+      std::uint16_t node = heap.pop();
+      REQUIRE(pool[node].freq == (std::uint64_t)i);
+    }
+  }
+}
+
+TEST_CASE("Node pool", "[heap]") {
+  node_pool pool;
+  SECTION("children are indices") {
+    std::uint16_t left = pool.add('a', 1);
+    std::uint16_t right = pool.add('b', 2);
+    std::uint16_t root = pool.add(0, 3, node_type_t::FILLER);
+    pool[root].left = left;
+    pool[root].right = right;
+    REQUIRE(pool.size() == 3);
+    REQUIRE(pool[pool[root].left].byte == 'a');
+    REQUIRE(pool[pool[root].right].byte == 'b');
+    REQUIRE(pool[left].left == NO_NODE);
+    REQUIRE(pool.tree_height(root) == 2);
+  }
+
+  SECTION("full pool") {
+    for (std::size_t i = 0; i < NODES_SIZE; i++) {
+      REQUIRE(pool.add(0, i) == i);
+    }
+    REQUIRE(pool.add(0, 0) == NO_NODE);
+    REQUIRE(pool.size() == NODES_SIZE);
+  }
 }
 
+/* counts what goes through it, the counts are shared by its copies */
+template <typename T> struct counting_allocator {
+  using value_type = T;
+  std::size_t *allocations;
+
+  explicit counting_allocator(std::size_t *allocations)
+      : allocations(allocations) {}
+  template <typename U>
+  counting_allocator(const counting_allocator<U> &other)
+      : allocations(other.allocations) {}
+
+  T *allocate(std::size_t n) {
+    (*allocations)++;
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T *p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+
+  bool operator==(const counting_allocator &other) const {
+    return allocations == other.allocations;
+  }
+  bool operator!=(const counting_allocator &other) const {
+    return !(*this == other);
+  }
+};
+
 TEST_CASE("Vectors", "[vector]") {
   SECTION("initializing") {
     vec<int> v1;
-    for(int i = 0; i < v1.capacity(); i++) {
-      REQUIRE(v1[i] == 0);
+    REQUIRE(v1.size() == 0);
+    REQUIRE(v1.capacity() == 0);
+    vec<int> v2(100);
+    REQUIRE(v2.size() == 100);
+    for (std::size_t i = 0; i < v2.size(); i++) {
+      REQUIRE(v2[i] == 0);
     }
   }
 
   SECTION("inserting") {
     vec<int> vector;
+    vector.resize(1);
     vector[0] = 123;
     REQUIRE(vector[0] == 123);
+    REQUIRE_THROWS_AS(vector.get(1), std::range_error);
   }
 
   SECTION("push back") {
@@ -91,6 +157,83 @@ TEST_CASE("Vectors", "[vector]") {
     vector.front() = 0xff;
     REQUIRE(vector.front() == 0xff);
   }
+
+  SECTION("growing keeps the elements") {
+    vec<int> vector;
+    for (int i = 0; i < 10000; i++) {
+      vector.push_back(i);
+    }
+    REQUIRE(vector.size() == 10000);
+    REQUIRE(vector.capacity() >= 10000);
+    REQUIRE(vector.capacity() < 20000);
+    for (int i = 0; i < 10000; i++) {
+      REQUIRE(vector[i] == i);
+    }
+    vector.resize_uninitialized(20000);
+    REQUIRE(vector[9999] == 9999);
+    vector.resize(5);
+    vector.resize(10, 7);
+    REQUIRE(vector[4] == 4);
+    REQUIRE(vector[5] == 7);
+    REQUIRE(vector.back() == 7);
+  }
+
+  SECTION("non trivial elements") {
+    vec<std::string> vector;
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(vector.emplace_back(40, 'a' + i % 26).size() == 40);
+    }
+    vec<std::string> copy = vector;
+    vector.pop_back();
+    REQUIRE(vector.size() == 99);
+    REQUIRE(copy.size() == 100);
+    REQUIRE(copy.back() == std::string(40, 'a' + 99 % 26));
+    copy = vector;
+    REQUIRE(copy.size() == 99);
+    for (std::size_t i = 0; i < copy.size(); i++) {
+      REQUIRE(copy[i] == vector[i]);
+    }
+  }
+
+  SECTION("moving doesn't allocate") {
+    std::size_t allocations = 0;
+    counting_allocator<int> allocator(&allocations);
+    vec<int, counting_allocator<int>> vector(allocator);
+    REQUIRE(allocations == 0);
+    for (int i = 0; i < 100; i++) {
+      vector.push_back(i);
+    }
+    const std::size_t grown = allocations;
+    const int *data = vector.data();
+
+    vec<int, counting_allocator<int>> moved(std::move(vector));
+    REQUIRE(allocations == grown);
+    REQUIRE(moved.data() == data);
+    REQUIRE(moved.size() == 100);
+    REQUIRE(vector.size() == 0);
+    REQUIRE(vector.capacity() == 0);
+
+    vec<int, counting_allocator<int>> assigned(allocator);
+    assigned = std::move(moved);
+    REQUIRE(allocations == grown);
+    REQUIRE(assigned.data() == data);
+    REQUIRE(assigned[99] == 99);
+  }
+
+  SECTION("shrink to fit") {
+    vec<int> vector;
+    vector.reserve(1000);
+    REQUIRE(vector.capacity() == 1000);
+    vector.push_back(1);
+    vector.push_back(2);
+    vector.shrink_to_fit();
+    REQUIRE(vector.capacity() == 2);
+    REQUIRE(vector[1] == 2);
+    vector.clear();
+    vector.shrink_to_fit();
+    REQUIRE(vector.capacity() == 0);
+    REQUIRE(vector.data() == nullptr);
+  }
 }
 
 TEST_CASE("Bitstrings", "[bitstring]") {
@@ -169,6 +312,7 @@ TEST_CASE("Bitstrings", "[bitstring]") {
 
   SECTION("simple encoding") {
     bitstring start(0), append(0xff), end_value(0xff);
+    start.len = 0;
     append.len = 8;
     start.encode(append);
     REQUIRE(start == end_value);
@@ -191,4 +335,397 @@ TEST_CASE("Bitstrings", "[bitstring]") {
     end_result.len = start.len;
     REQUIRE(start == end_result);
   }
+
+  SECTION("encoding across words") {
+    bitstring start, append(0x5, 3);
+    for (int i = 0; i < 100; i++) {
+      start.encode(append);
+    }
+    REQUIRE(start.len == 300);
+    for (std::size_t bit = 0; bit < 300; bit++) {
+      REQUIRE(start.get_bit(bit) == ((0x5 >> (bit % 3)) & 1));
+    }
+    REQUIRE(start.popcount() == 200);
+  }
+
+  SECTION("shifting right") {
+    std::uint8_t bytes[] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0,
+                            0x0f, 0xed};
+    bitstring bs(bytes, 10);
+    bitstring shifted = (bs << 75) >> 75;
+    REQUIRE(shifted == bs);
+    REQUIRE((bs >> 8) == bitstring(bytes + 1, 9));
+    REQUIRE((bs >> 80).len == 0);
+    REQUIRE((bs >> 4).get_bit(0) == 1);
+    REQUIRE((bs >> 4).len == 76);
+  }
+
+  SECTION("comparing honours the length") {
+    bitstring bs(0x0f), other(0xff);
+    bs.len = other.len = 4;
+    REQUIRE(bs == other);
+    other.len = 5;
+    REQUIRE(bs != other);
+  }
+
+  SECTION("reversing") {
+    bitstring bs;
+    std::mt19937 rng(7);
+    for (int bit = 0; bit < 150; bit++) {
+      if (rng() & 1) {
+        bs.set_bit(bit);
+      }
+    }
+    bs.len = 150;
+    bitstring reversed = bs;
+    reversed.reverse();
+    REQUIRE(reversed.len == 150);
+    for (int bit = 0; bit < 150; bit++) {
+      REQUIRE(reversed.get_bit(bit) == bs.get_bit(149 - bit));
+    }
+    REQUIRE(reversed.reverse() == bs);
+  }
+
+  SECTION("counting bits") {
+    bitstring bs;
+    bs.set_bit(3);
+    bs.set_bit(70);
+    bs.set_bit(200);
+    bs.len = 100;
+    REQUIRE(bs.popcount() == 2);
+    REQUIRE(bs.leading_zeros() == 29);
+    bs.len = 70;
+    REQUIRE(bs.leading_zeros() == 66);
+    bs.unset_bit(3);
+    REQUIRE(bs.leading_zeros() == 70);
+  }
+}
+
+TEST_CASE("Bitwriter", "[bitwriter]") {
+  SECTION("same bit order as encoding") {
+    bitstring start(0), append(0xff), last(0xa);
+    start.len = 0;
+    append.len = 8;
+    last.len = 4;
+    start.encode(append);
+    start.encode(last);
+    start.encode(append);
+
+    std::vector<std::uint8_t> out;
+    bitwriter writer(out);
+    writer.write(append);
+    writer.write(last);
+    writer.write(append);
+    writer.finish();
+
+    REQUIRE(writer.bits_written() == start.len);
+    REQUIRE(out.size() == 3);
+    for (std::size_t bit = 0; bit < start.len; bit++) {
+      REQUIRE(((out[bit / 8] >> (bit % 8)) & 1) == start.get_bit(bit));
+    }
+  }
+
+  SECTION("codes crossing a word boundary") {
+    std::vector<std::uint8_t> out;
+    bitwriter writer(out);
+    for (int i = 0; i < 100; i++) {
+      writer.write(0x5, 3);
+    }
+    writer.finish();
+    REQUIRE(writer.bits_written() == 300);
+    REQUIRE(out.size() == 38);
+    for (std::size_t bit = 0; bit < 300; bit++) {
+      std::uint8_t expected = (0x5 >> (bit % 3)) & 1;
+      REQUIRE(((out[bit / 8] >> (bit % 8)) & 1) == expected);
+    }
+  }
+}
+
+TEST_CASE("Bitreader", "[bitreader]") {
+  std::mt19937 rng(3);
+  std::vector<std::pair<std::uint32_t, std::uint8_t>> codes;
+  std::vector<std::uint8_t> data;
+  bitwriter writer(data);
+  for (int i = 0; i < 1000; i++) {
+    const std::uint8_t len = 1 + rng() % 24;
+    const std::uint32_t code = rng() & ((1u << len) - 1);
+    codes.push_back({code, len});
+    writer.write(code, len);
+  }
+  writer.finish();
+
+  SECTION("reads back what the bitwriter wrote") {
+    bitreader reader(data.data(), data.size());
+    for (const auto &[code, len] : codes) {
+      reader.refill();
+      REQUIRE(reader.available() >= 56);
+      REQUIRE(reader.peek(len) == code);
+      reader.consume(len);
+    }
+  }
+
+  SECTION("starting in the middle of a byte") {
+    for (std::uint8_t skip = 1; skip < 8; skip++) {
+      bitreader reader(data.data(), data.size(), skip);
+      bitreader whole(data.data(), data.size());
+      whole.refill();
+      whole.consume(skip);
+      for (int i = 0; i < 100; i++) {
+        reader.refill();
+        whole.refill();
+        REQUIRE(reader.read(13) == whole.read(13));
+      }
+    }
+  }
+
+  SECTION("zeroes past the end") {
+    const std::uint8_t bytes[] = {0xff, 0x81, 0x3};
+    bitreader reader(bytes, sizeof(bytes));
+    reader.refill();
+    REQUIRE(reader.peek(24) == 0x381ff);
+    reader.consume(20);
+    for (int i = 0; i < 10; i++) {
+      reader.refill();
+      REQUIRE(reader.read(40) == 0);
+    }
+  }
+}
+
+static path_t make_path(std::uint8_t character, std::uint32_t code,
+                        std::uint8_t len) {
+  path_t path;
+  path.character = character;
+  path.len = len;
+  for (std::uint8_t bit = 0; bit < len; bit++) {
+    if ((code >> bit) & 1) {
+      path.path.set_bit(bit);
+    } else {
+      path.path.unset_bit(bit);
+    }
+  }
+  path.path.len = len;
+  return path;
+}
+
+TEST_CASE("Decode table", "[decode]") {
+  SECTION("short codes, two symbols per lookup") {
+    /* a = 0, b = 01, c = 11 written least significant bit first */
+    path_t paths[] = {make_path('a', 0x0, 1), make_path('b', 0x1, 2),
+                      make_path('c', 0x3, 2)};
+    decode_table table;
+    REQUIRE(table.build(paths, 3));
+
+    std::vector<std::uint8_t> data;
+    bitwriter writer(data);
+    const std::string input = "abcaacbba";
+    for (char c : input) {
+      const path_t &path = paths[c - 'a'];
+      writer.write(path.path);
+    }
+    writer.finish();
+
+    std::vector<std::uint8_t> out(table.max_symbols(writer.bits_written()));
+    std::size_t written = 0;
+    REQUIRE(table.decode(data.data(), data.size(), writer.bits_written(),
+                         out.data(), out.size(), written));
+    REQUIRE(std::string(out.begin(), out.begin() + written) == input);
+  }
+
+  SECTION("codes longer than the primary table") {
+    /* 0, 10, 110, ... a chain of 20 codes with the last two the same length */
+    path_t paths[20];
+    for (int i = 0; i < 19; i++) {
+      paths[i] = make_path(i, (1u << i) - 1, i + 1);
+    }
+    paths[19] = make_path(19, (1u << 19) - 1, 19);
+
+    decode_table table;
+    REQUIRE(table.build(paths, 20));
+
+    std::vector<std::uint8_t> data;
+    bitwriter writer(data);
+    for (int i = 19; i >= 0; i--) {
+      writer.write(paths[i].path);
+    }
+    writer.finish();
+
+    std::vector<std::uint8_t> out(table.max_symbols(writer.bits_written()));
+    std::size_t written = 0;
+    REQUIRE(table.decode(data.data(), data.size(), writer.bits_written(),
+                         out.data(), out.size(), written));
+    REQUIRE(written == 20);
+    for (int i = 0; i < 20; i++) {
+      REQUIRE(out[i] == 19 - i);
+    }
+  }
+
+  SECTION("rejects paths that aren't a prefix code") {
+    path_t paths[] = {make_path('a', 0x0, 1), make_path('b', 0x0, 2)};
+    decode_table table;
+    REQUIRE_FALSE(table.build(paths, 2));
+  }
+}
+
+TEST_CASE("Canonical codes", "[codes]") {
+  SECTION("assigning codes") {
+    /* the example from RFC 1951, A-H with lengths 3 3 3 3 3 2 4 4 */
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    const std::uint8_t example[] = {3, 3, 3, 3, 3, 2, 4, 4};
+    const std::uint32_t expected[] = {0x2, 0x3, 0x4, 0x5, 0x6, 0x0, 0xe, 0xf};
+    std::copy(example, example + 8, lengths + 'A');
+
+    path_t paths[UCHAR_MAX + 1];
+    REQUIRE(canonical_paths(lengths, paths));
+    for (int i = 0; i < 8; i++) {
+      const path_t &path = paths['A' + i];
+      REQUIRE(path.character == 'A' + i);
+      REQUIRE(path.len == example[i]);
+      for (std::uint8_t bit = 0; bit < path.len; bit++) {
+        REQUIRE(path.path.get_bit(bit) ==
+                ((expected[i] >> (path.len - 1 - bit)) & 1));
+      }
+    }
+    REQUIRE(paths['A' + 8].len == 0);
+  }
+
+  SECTION("rejecting lengths that don't fit") {
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    lengths[0] = lengths[1] = lengths[2] = 1;
+    path_t paths[UCHAR_MAX + 1];
+    REQUIRE_FALSE(canonical_paths(lengths, paths));
+  }
+
+  SECTION("length header round trip") {
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    lengths['a'] = 1;
+    lengths['b'] = 2;
+    lengths['c'] = 2;
+    std::vector<std::uint8_t> header;
+    write_code_lengths(lengths, header);
+    REQUIRE(header.size() < 16);
+
+    std::uint8_t read[UCHAR_MAX + 1] = {0};
+    REQUIRE(read_code_lengths(header.data(), header.size(), read) ==
+            header.size());
+    REQUIRE(std::equal(lengths, lengths + UCHAR_MAX + 1, read));
+    REQUIRE(read_code_lengths(header.data(), header.size() - 1, read) == 0);
+  }
+
+  SECTION("raw length header") {
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    for (int i = 0; i < UCHAR_MAX + 1; i++) {
+      lengths[i] = 8 + i % 2;
+    }
+    std::vector<std::uint8_t> header;
+    write_code_lengths(lengths, header);
+    REQUIRE(header.size() == UCHAR_MAX + 2);
+
+    std::uint8_t read[UCHAR_MAX + 1] = {0};
+    REQUIRE(read_code_lengths(header.data(), header.size(), read) ==
+            header.size());
+    REQUIRE(std::equal(lengths, lengths + UCHAR_MAX + 1, read));
+  }
+}
+
+TEST_CASE("Length limited codes", "[codes]") {
+  /* fibonacci frequencies make the deepest possible huffman tree */
+  std::uint64_t frequencies[UCHAR_MAX + 1] = {0};
+  frequencies[0] = frequencies[1] = 1;
+  for (int i = 2; i < 30; i++) {
+    frequencies[i] = frequencies[i - 1] + frequencies[i - 2];
+  }
+
+  SECTION("limiting the length") {
+    for (std::uint8_t limit : {5, 8, 11, 15}) {
+      std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+      REQUIRE(limit_code_lengths(frequencies, limit, lengths));
+      /* kraft sum of a complete code is exactly 1 */
+      std::uint64_t kraft = 0;
+      for (int i = 0; i < 30; i++) {
+        REQUIRE(lengths[i] >= 1);
+        REQUIRE(lengths[i] <= limit);
+        kraft += 1llu << (limit - lengths[i]);
+      }
+      REQUIRE(kraft == 1llu << limit);
+      REQUIRE(lengths[30] == 0);
+
+      path_t paths[UCHAR_MAX + 1];
+      REQUIRE(canonical_paths(lengths, paths));
+    }
+  }
+
+  SECTION("same as huffman when the limit isn't reached") {
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    REQUIRE(limit_code_lengths(frequencies, 29, lengths));
+    REQUIRE(lengths[29] == 1);
+    REQUIRE(lengths[0] == 29);
+    REQUIRE(lengths[1] == 29);
+  }
+
+  SECTION("too short for the alphabet") {
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    REQUIRE_FALSE(limit_code_lengths(frequencies, 4, lengths));
+  }
+
+  SECTION("single symbol") {
+    std::uint64_t single[UCHAR_MAX + 1] = {0};
+    single['y'] = 100;
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    REQUIRE(limit_code_lengths(single, 8, lengths));
+    REQUIRE(lengths['y'] == 1);
+  }
+}
+
+TEST_CASE("Code lengths without a tree", "[codes]") {
+  std::mt19937_64 rng(7);
+  for (int round = 0; round < 50; round++) {
+    std::uint64_t frequencies[UCHAR_MAX + 1] = {0};
+    const int used = 2 + rng() % (UCHAR_MAX);
+    for (int i = 0; i < used; i++) {
+      frequencies[rng() % (UCHAR_MAX + 1)] = 1 + rng() % (round % 2 ? 5 : 100000);
+    }
+
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    const std::uint8_t longest = huffman_code_lengths(frequencies, lengths);
+
+    /* the tree gives an optimal code, so both have to cost the same */
+    huffman_options options;
+    options.max_code_len = UINT8_MAX;
+    path_t paths[UCHAR_MAX + 1];
+    REQUIRE(huffman_paths(frequencies, options, paths));
+    std::uint64_t cost = 0, tree_cost = 0, kraft = 0;
+    std::uint8_t max_len = 0;
+    for (int i = 0; i < UCHAR_MAX + 1; i++) {
+      REQUIRE((lengths[i] == 0) == (frequencies[i] == 0));
+      cost += frequencies[i] * lengths[i];
+      tree_cost += frequencies[i] * paths[i].len;
+      max_len = std::max(max_len, lengths[i]);
+      if (lengths[i] != 0) {
+        kraft += 1llu << (63 - lengths[i]);
+      }
+    }
+    REQUIRE(cost == tree_cost);
+    REQUIRE(longest == max_len);
+    REQUIRE(kraft == 1llu << 63);
+  }
+
+  SECTION("single symbol") {
+    std::uint64_t single[UCHAR_MAX + 1] = {0};
+    single['y'] = 100;
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    REQUIRE(huffman_code_lengths(single, lengths) == 1);
+    REQUIRE(lengths['y'] == 1);
+  }
+
+  SECTION("fibonacci") {
+    std::uint64_t frequencies[UCHAR_MAX + 1] = {0};
+    frequencies[0] = frequencies[1] = 1;
+    for (int i = 2; i < 30; i++) {
+      frequencies[i] = frequencies[i - 1] + frequencies[i - 2];
+    }
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    REQUIRE(huffman_code_lengths(frequencies, lengths) == 29);
+    REQUIRE(lengths[29] == 1);
+    REQUIRE(lengths[0] == 29);
+  }
 }
@@ -0,0 +1,1013 @@
+#include "../../headers/block.h"
+#include "../../headers/bytes.h"
+#include "../../headers/codes.h"
+#include "../../headers/encode_table.h"
+#include "../../headers/histogram.h"
+#include "../../headers/huffman.h"
+#include "../../headers/lz77.h"
+#include "../../headers/mapped_file.h"
+#include "../../headers/parallel.h"
+#include "../../headers/tira.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+#include <catch2/catch_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+static std::vector<std::uint8_t> text(std::size_t size) {
+  const std::string words = "the quick brown fox jumps over the lazy dog\n";
+  std::vector<std::uint8_t> data(size);
+  for (std::size_t i = 0; i < size; i++) {
+    data[i] = words[i % words.size()];
+  }
+  return data;
+}
+
+static std::vector<std::uint8_t> noise(std::size_t size) {
+  std::mt19937 rng(42);
+  std::vector<std::uint8_t> data(size);
+  for (std::uint8_t &byte : data) {
+    byte = rng();
+  }
+  return data;
+}
+
+TEST_CASE("Huffman coding", "[huffman]") {
+  huffman_options options;
+
+  SECTION("round trip") {
+    for (const std::vector<std::uint8_t> &data :
+         {text(1), text(1000), noise(5000), std::vector<std::uint8_t>(300, 'y')}) {
+      std::vector<std::uint8_t> encoded;
+      REQUIRE(huffman_encode(data.data(), data.size(), options, encoded));
+
+      std::vector<std::uint8_t> decoded(data.size());
+      REQUIRE(huffman_decode(encoded.data(), encoded.size(), decoded.data(),
+                             decoded.size()) == encoded.size());
+      REQUIRE(decoded == data);
+    }
+  }
+
+  SECTION("text gets smaller") {
+    std::vector<std::uint8_t> data = text(10000);
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(huffman_encode(data.data(), data.size(), options, encoded));
+    REQUIRE(encoded.size() < data.size() * 6 / 10);
+  }
+
+  SECTION("sync points") {
+    for (std::uint32_t interval : {1u, 7u, 100u, 999u, 1000u, 5000u}) {
+      options.sync_interval = interval;
+      std::vector<std::uint8_t> data = text(1000);
+      std::vector<std::uint8_t> encoded;
+      REQUIRE(huffman_encode(data.data(), data.size(), options, encoded));
+
+      for (unsigned threads : {1u, 4u}) {
+        std::vector<std::uint8_t> decoded(data.size());
+        REQUIRE(huffman_decode(encoded.data(), encoded.size(), decoded.data(),
+                               decoded.size(), threads) == encoded.size());
+        REQUIRE(decoded == data);
+      }
+    }
+  }
+
+  SECTION("sync points out of order") {
+    options.sync_interval = 100;
+    std::vector<std::uint8_t> data = text(1000);
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(huffman_encode(data.data(), data.size(), options, encoded));
+
+    /* the code lengths are runs here, find the interval after total bits */
+    std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+    std::size_t position =
+        read_code_lengths(encoded.data(), encoded.size(), lengths) +
+        sizeof(std::uint64_t);
+    REQUIRE(read_value<std::uint32_t>(encoded.data() + position) == 100);
+    position += sizeof(std::uint32_t);
+    std::swap_ranges(encoded.begin() + position,
+                     encoded.begin() + position + sizeof(std::uint64_t),
+                     encoded.begin() + position + sizeof(std::uint64_t));
+
+    std::vector<std::uint8_t> decoded(data.size());
+    REQUIRE(huffman_decode(encoded.data(), encoded.size(), decoded.data(),
+                           decoded.size()) == 0);
+  }
+
+  SECTION("wrong size or truncated data") {
+    std::vector<std::uint8_t> data = text(1000);
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(huffman_encode(data.data(), data.size(), options, encoded));
+
+    std::vector<std::uint8_t> decoded(data.size() + 1);
+    REQUIRE(huffman_decode(encoded.data(), encoded.size(), decoded.data(),
+                           decoded.size()) == 0);
+    REQUIRE(huffman_decode(encoded.data(), encoded.size(), decoded.data(),
+                           data.size() - 1) == 0);
+    REQUIRE(huffman_decode(encoded.data(), encoded.size() - 1, decoded.data(),
+                           data.size()) == 0);
+  }
+
+  SECTION("interleaved streams") {
+    options.interleave = true;
+    options.canonical = true;
+    std::vector<std::vector<std::uint8_t>> inputs = {text(20000), noise(5000)};
+    for (std::size_t size = 1; size <= 9; size++) {
+      inputs.push_back(text(size));
+    }
+    for (const std::vector<std::uint8_t> &data : inputs) {
+      std::uint64_t frequencies[UCHAR_MAX + 1] = {0};
+      histogram(data.data(), data.size(), frequencies);
+      path_t paths[UCHAR_MAX + 1];
+      REQUIRE(huffman_paths(frequencies, options, paths));
+      std::vector<std::uint8_t> encoded;
+      REQUIRE(huffman_encode_interleaved(data.data(), data.size(),
+                                         frequencies, paths, encoded));
+      REQUIRE(encoded.size() <=
+              huffman_encoded_size(frequencies, paths, data.size(), options));
+
+      std::vector<std::uint8_t> decoded(data.size());
+      REQUIRE(huffman_decode_interleaved(encoded.data(), encoded.size(),
+                                         decoded.data(), decoded.size()) ==
+              encoded.size());
+      REQUIRE(decoded == data);
+
+      /* a stream with a bit less or more than it decodes */
+      std::uint8_t lengths[UCHAR_MAX + 1] = {0};
+      const std::size_t bits =
+          read_code_lengths(encoded.data(), encoded.size(), lengths);
+      encoded[bits]++;
+      REQUIRE(huffman_decode_interleaved(encoded.data(), encoded.size(),
+                                         decoded.data(), decoded.size()) == 0);
+      encoded[bits] -= 2;
+      REQUIRE(huffman_decode_interleaved(encoded.data(), encoded.size(),
+                                         decoded.data(), decoded.size()) == 0);
+    }
+  }
+
+  SECTION("encode table writes the same bits as the paths") {
+    for (bool canonical : {false, true}) {
+      options.canonical = canonical;
+      const std::vector<std::uint8_t> data = text(5000);
+      std::uint64_t frequencies[UCHAR_MAX + 1] = {0};
+      histogram(data.data(), data.size(), frequencies);
+      path_t paths[UCHAR_MAX + 1];
+      REQUIRE(huffman_paths(frequencies, options, paths));
+      const encode_table table(paths);
+      for (int byte = 0; byte < UCHAR_MAX + 1; byte++) {
+        REQUIRE(table.lengths[byte] == paths[byte].len);
+        REQUIRE(table.codes[byte] >> table.lengths[byte] == 0);
+      }
+
+      std::vector<std::uint8_t> from_paths, from_table;
+      bitwriter path_writer(from_paths), table_writer(from_table);
+      for (std::uint8_t byte : data) {
+        path_writer.write(paths[byte].path);
+        table.write(table_writer, byte);
+      }
+      path_writer.finish();
+      table_writer.finish();
+      REQUIRE(table_writer.bits_written() == path_writer.bits_written());
+      REQUIRE(from_table == from_paths);
+    }
+  }
+}
+
+TEST_CASE("Histogram", "[histogram]") {
+  std::vector<std::uint8_t> data = noise(100000);
+  /* runs of different lengths in the middle of the noise */
+  for (std::size_t i = 20000, run = 1; i + run < 80000; i += 2 * run, run++) {
+    std::fill(data.begin() + i, data.begin() + i + run, (std::uint8_t)run);
+  }
+  std::fill(data.begin() + 90000, data.end(), 0);
+
+  for (histogram_kernel_t kernel :
+       {HISTOGRAM_AUTO, HISTOGRAM_SCALAR, HISTOGRAM_SSE2, HISTOGRAM_AVX2}) {
+    /* unaligned starts and sizes that don't fill a whole vector */
+    for (std::size_t offset : {0, 1, 7, 31}) {
+      for (std::size_t size : {0, 1, 4095, 4096, 50001, 99969}) {
+        std::uint64_t expected[UCHAR_MAX + 1] = {0};
+        std::uint64_t counted[UCHAR_MAX + 1] = {0};
+        for (std::size_t i = 0; i < size; i++) {
+          expected[data[offset + i]]++;
+        }
+        histogram(data.data() + offset, size, counted, kernel);
+        REQUIRE(std::equal(expected, expected + UCHAR_MAX + 1, counted));
+      }
+    }
+  }
+
+  SECTION("adds to the counts") {
+    std::uint64_t counted[UCHAR_MAX + 1] = {0};
+    counted[0] = 5;
+    histogram(data.data(), data.size(), counted);
+    histogram(data.data(), data.size(), counted);
+    REQUIRE(counted[0] ==
+            5 + 2 * (std::uint64_t)std::count(data.begin(), data.end(), 0));
+  }
+}
+
+TEST_CASE("Blocks", "[block]") {
+  huffman_options options;
+
+  SECTION("block round trip") {
+    std::vector<std::uint8_t> data = text(4000);
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(encode_block(data.data(), data.size(), options, encoded));
+
+    block_header header;
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    REQUIRE(header.raw_size == data.size());
+    REQUIRE(header.payload_size + block_header::SIZE == encoded.size());
+
+    std::vector<std::uint8_t> decoded(header.raw_size);
+    REQUIRE(decode_block(header, encoded.data() + block_header::SIZE,
+                         decoded.data()));
+    REQUIRE(decoded == data);
+  }
+
+  SECTION("truncated block header") {
+    std::vector<std::uint8_t> data = text(100);
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(encode_block(data.data(), data.size(), options, encoded));
+    block_header header;
+    REQUIRE_FALSE(read_block_header(encoded.data(), encoded.size() - 1, header));
+  }
+
+  SECTION("container header") {
+    container_header header, read;
+    header.flags = CONTAINER_INDEXED;
+    header.block_size = 1 << 20;
+    header.original_size = 123456789;
+    header.block_count = 118;
+    std::vector<std::uint8_t> out;
+    write_container_header(header, out);
+    REQUIRE(out.size() == container_header::SIZE);
+    REQUIRE(read_container_header(out.data(), out.size(), read));
+    REQUIRE(read.flags == header.flags);
+    REQUIRE(read.block_size == header.block_size);
+    REQUIRE(read.original_size == header.original_size);
+    REQUIRE(read.block_count == header.block_count);
+
+    out[0] = 'X';
+    REQUIRE_FALSE(read_container_header(out.data(), out.size(), read));
+  }
+
+  SECTION("container index") {
+    huffman_options container_options;
+    container_options.block_size = 4096;
+    tira_compressor compressor(container_options);
+    const std::vector<std::uint8_t> data = text(20000);
+    std::vector<std::uint8_t> compressed(
+        tira_compress_bound(data.size(), container_options));
+    std::size_t written = 0;
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                compressed.size(), written) == TIRA_OK);
+    compressed.resize(written);
+    container_header header;
+    REQUIRE(
+        read_container_header(compressed.data(), compressed.size(), header));
+    REQUIRE(
+        check_container_index(compressed.data(), compressed.size(), header));
+
+    /* data after the last block, a missing block and a moved block */
+    std::vector<std::uint8_t> longer = compressed;
+    longer.push_back(0);
+    REQUIRE_FALSE(check_container_index(longer.data(), longer.size(), header));
+    container_header fewer = header;
+    fewer.block_count--;
+    REQUIRE_FALSE(
+        check_container_index(compressed.data(), compressed.size(), fewer));
+    std::vector<std::uint8_t> moved = compressed;
+    moved[container_header::SIZE + sizeof(std::uint64_t)]++;
+    REQUIRE_FALSE(check_container_index(moved.data(), moved.size(), header));
+
+    /* a header claiming a terabyte without the blocks for it */
+    container_header huge;
+    huge.flags = CONTAINER_INDEXED;
+    huge.block_size = 1 << 20;
+    huge.original_size = 1ull << 40;
+    huge.block_count = 1 << 20;
+    std::vector<std::uint8_t> out;
+    write_container_header(huge, out);
+    REQUIRE_FALSE(check_container_index(out.data(), out.size(), huge));
+  }
+
+  SECTION("end block and payload bound") {
+    std::vector<std::uint8_t> out;
+    write_end_block(out);
+    block_header header;
+    REQUIRE(read_block_header(out.data(), out.size(), header));
+    REQUIRE(header.method == END_BLOCK);
+    REQUIRE(header.payload_size == 0);
+
+    /* every sync point and the longest codes still fit in the bound */
+    std::vector<std::uint8_t> data = noise(1000);
+    std::vector<std::uint8_t> encoded;
+    options.sync_interval = 1;
+    options.max_code_len = MAX_CODE_LEN_LIMIT;
+    REQUIRE(huffman_encode(data.data(), data.size(), options, encoded));
+    REQUIRE(encoded.size() <= max_payload_size(data.size()));
+  }
+
+  SECTION("picking the method") {
+    struct {
+      std::vector<std::uint8_t> data;
+      block_method_t method;
+    } cases[] = {
+        {text(5000), HUFFMAN_BLOCK},
+        {noise(5000), STORED_BLOCK},
+        {std::vector<std::uint8_t>(5000, 'y'), RLE_BLOCK},
+        {{}, STORED_BLOCK},
+    };
+    for (const auto &c : cases) {
+      std::vector<std::uint8_t> encoded;
+      REQUIRE(encode_block(c.data.data(), c.data.size(), options, encoded));
+      block_header header;
+      REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+      REQUIRE(header.method == c.method);
+      /* nothing ever grows by more than the header */
+      REQUIRE(header.payload_size <= c.data.size() + 1);
+
+      std::vector<std::uint8_t> decoded(header.raw_size);
+      REQUIRE(decode_block(header, encoded.data() + block_header::SIZE,
+                           decoded.data()));
+      REQUIRE(decoded == c.data);
+    }
+  }
+
+  SECTION("interleaved blocks") {
+    options.interleave = true;
+    std::vector<std::uint8_t> data = text(5000);
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(encode_block(data.data(), data.size(), options, encoded));
+    block_header header;
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    REQUIRE(header.method == HUFFMAN4_BLOCK);
+    std::vector<std::uint8_t> decoded(header.raw_size);
+    REQUIRE(decode_block(header, encoded.data() + block_header::SIZE,
+                         decoded.data()));
+    REQUIRE(decoded == data);
+
+    /* sync points win over interleaving */
+    options.sync_interval = 1000;
+    encoded.clear();
+    REQUIRE(encode_block(data.data(), data.size(), options, encoded));
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    REQUIRE(header.method == HUFFMAN_BLOCK);
+  }
+
+  SECTION("corrupt stored and rle blocks") {
+    std::vector<std::uint8_t> payload(10, 'x'), decoded(10);
+    block_header header;
+    header.raw_size = 10;
+    header.method = STORED_BLOCK;
+    header.payload_size = 9;
+    REQUIRE_FALSE(decode_block(header, payload.data(), decoded.data()));
+    header.method = RLE_BLOCK;
+    header.payload_size = 2;
+    REQUIRE_FALSE(decode_block(header, payload.data(), decoded.data()));
+  }
+}
+
+TEST_CASE("Order-1 contexts", "[context]") {
+  huffman_options options;
+
+  /* every letter is followed by one of the 3 letters after it */
+  std::mt19937 rng(5);
+  std::vector<std::uint8_t> chain(50000);
+  std::uint8_t previous = 'a';
+  for (std::uint8_t &byte : chain) {
+    byte = 'a' + (previous - 'a' + 1 + rng() % 3) % 26;
+    previous = byte;
+  }
+
+  auto round_trip = [](const std::vector<std::uint8_t> &data,
+                       const huffman_options &options) {
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(huffman_encode_context(data.data(), data.size(), options,
+                                   encoded));
+    std::vector<std::uint8_t> decoded(data.size());
+    REQUIRE(huffman_decode_context(encoded.data(), encoded.size(),
+                                   decoded.data(),
+                                   decoded.size()) == encoded.size());
+    REQUIRE(decoded == data);
+    return encoded;
+  };
+
+  SECTION("round trip") {
+    for (const std::vector<std::uint8_t> &data :
+         {text(1), text(2), text(1000), noise(20000), chain,
+          std::vector<std::uint8_t>(300, 'y')}) {
+      round_trip(data, options);
+    }
+    std::vector<std::uint8_t> empty;
+    REQUIRE_FALSE(huffman_encode_context(nullptr, 0, options, empty));
+  }
+
+  SECTION("smaller than one table") {
+    std::vector<std::uint8_t> plain;
+    REQUIRE(huffman_encode(chain.data(), chain.size(), options, plain));
+    const std::vector<std::uint8_t> encoded = round_trip(chain, options);
+    /* 2 bits or less a letter instead of about 4.7 */
+    REQUIRE(encoded.size() < plain.size() / 2);
+    REQUIRE(encoded[0] <= MAX_CONTEXT_TABLES);
+    /* a table has to save more than its header costs */
+    REQUIRE(round_trip(text(50), options)[0] == 1);
+    REQUIRE(round_trip(noise(20000), options)[0] == 1);
+  }
+
+  SECTION("short codes") {
+    options.max_code_len = MIN_CODE_LEN_LIMIT;
+    round_trip(noise(20000), options);
+  }
+
+  SECTION("corrupt data") {
+    const std::vector<std::uint8_t> encoded = round_trip(chain, options);
+    std::vector<std::uint8_t> decoded(chain.size());
+    REQUIRE(huffman_decode_context(encoded.data(), encoded.size() - 1,
+                                   decoded.data(), decoded.size()) == 0);
+    REQUIRE(huffman_decode_context(encoded.data(), encoded.size(),
+                                   decoded.data(), decoded.size() - 1) == 0);
+    std::vector<std::uint8_t> tables = encoded;
+    tables[0] = 0;
+    REQUIRE(huffman_decode_context(tables.data(), tables.size(),
+                                   decoded.data(), decoded.size()) == 0);
+    /* a context pointing past the last table */
+    tables = encoded;
+    tables[1] = 0xff;
+    REQUIRE(huffman_decode_context(tables.data(), tables.size(),
+                                   decoded.data(), decoded.size()) == 0);
+  }
+
+  SECTION("picked for blocks") {
+    options.context = true;
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(encode_block(chain.data(), chain.size(), options, encoded));
+    block_header header;
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    REQUIRE(header.method == CONTEXT_BLOCK);
+    std::vector<std::uint8_t> decoded(header.raw_size);
+    REQUIRE(decode_block(header, encoded.data() + block_header::SIZE,
+                         decoded.data()));
+    REQUIRE(decoded == chain);
+
+    /* noise isn't made smaller by it, sync points rule it out */
+    std::vector<std::uint8_t> random = noise(5000);
+    encoded.clear();
+    REQUIRE(encode_block(random.data(), random.size(), options, encoded));
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    REQUIRE(header.method == STORED_BLOCK);
+    options.sync_interval = 1000;
+    encoded.clear();
+    REQUIRE(encode_block(chain.data(), chain.size(), options, encoded));
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    REQUIRE(header.method == HUFFMAN_BLOCK);
+  }
+}
+
+TEST_CASE("LZ77", "[lz77]") {
+  huffman_options options;
+  options.lz77 = true;
+
+  /* words picked at random so the text repeats, but not with one period */
+  std::mt19937 rng(7);
+  const char *words[] = {"error ", "warning ", "connection ", "closed ",
+                         "opened ", "user=", "id=", "\n"};
+  std::vector<std::uint8_t> log;
+  while (log.size() < 20000) {
+    const char *word = words[rng() % 8];
+    log.insert(log.end(), word, word + std::strlen(word));
+  }
+
+  auto round_trip = [&](const std::vector<std::uint8_t> &data) {
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(encode_block(data.data(), data.size(), options, encoded));
+    block_header header;
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    std::vector<std::uint8_t> decoded(header.raw_size);
+    REQUIRE(decode_block(header, encoded.data() + block_header::SIZE,
+                         decoded.data()));
+    REQUIRE(decoded == data);
+    return header;
+  };
+
+  SECTION("round trip") {
+    const block_header header = round_trip(log);
+    REQUIRE(header.method == LZ77_BLOCK);
+
+    options.lz77 = false;
+    std::vector<std::uint8_t> huffman;
+    REQUIRE(encode_block(log.data(), log.size(), options, huffman));
+    REQUIRE(header.payload_size + block_header::SIZE < huffman.size() / 2);
+  }
+
+  SECTION("short, random and overlapping data") {
+    round_trip(noise(5000));
+    round_trip({'a', 'b', 'c', 'a', 'b', 'c', 'a'});
+    std::vector<std::uint8_t> runs = text(3000);
+    runs.insert(runs.end(), 1000, 'x');
+    runs.insert(runs.end(), 1000, 'y');
+    REQUIRE(round_trip(runs).method == LZ77_BLOCK);
+  }
+
+  SECTION("window and search depth") {
+    for (std::uint32_t window : {LZ77_MIN_WINDOW, 1000u, LZ77_MAX_WINDOW}) {
+      options.window = window;
+      options.search_depth = 2;
+      lz77_streams streams;
+      lz77_parse(log.data(), log.size(), options, streams);
+      REQUIRE(streams.distance_low.size() == streams.sequences - 1);
+      for (std::size_t i = 0; i < streams.distance_low.size(); i++) {
+        REQUIRE((std::uint32_t)(streams.distance_low[i] |
+                                streams.distance_high[i] << 8) < window);
+      }
+      round_trip(log);
+    }
+  }
+
+  SECTION("levels") {
+    std::size_t sizes[MAX_LEVEL + 1] = {0};
+    for (int level = MIN_LEVEL; level <= MAX_LEVEL; level++) {
+      options = {};
+      huffman_level(level, options);
+      REQUIRE(options.lz77 == (level >= 3));
+      round_trip(log);
+      std::vector<std::uint8_t> encoded;
+      REQUIRE(encode_block(log.data(), log.size(), options, encoded));
+      sizes[level] = encoded.size();
+    }
+    REQUIRE(sizes[3] < sizes[2]);
+    REQUIRE(sizes[9] <= sizes[6]);
+    REQUIRE(sizes[6] <= sizes[3]);
+
+    /* a level out of range leaves the options alone */
+    huffman_options unchanged;
+    huffman_level(0, unchanged);
+    huffman_level(10, unchanged);
+    REQUIRE(unchanged.block_size == huffman_options{}.block_size);
+    REQUIRE_FALSE(unchanged.lz77);
+  }
+
+  SECTION("corrupt payload") {
+    std::vector<std::uint8_t> encoded;
+    REQUIRE(encode_block(log.data(), log.size(), options, encoded));
+    block_header header;
+    REQUIRE(read_block_header(encoded.data(), encoded.size(), header));
+    std::vector<std::uint8_t> decoded(header.raw_size);
+    const std::uint8_t *payload = encoded.data() + block_header::SIZE;
+
+    REQUIRE_FALSE(lz77_decode(payload, header.payload_size - 1,
+                              decoded.data(), decoded.size()));
+    REQUIRE_FALSE(lz77_decode(payload, header.payload_size, decoded.data(),
+                              decoded.size() - 1));
+    std::vector<std::uint8_t> sequences(encoded.begin() + block_header::SIZE,
+                                        encoded.end());
+    sequences[0]++;
+    REQUIRE_FALSE(lz77_decode(sequences.data(), sequences.size(),
+                              decoded.data(), decoded.size()));
+
+    /* the literals stream starts after the sequence count */
+    std::vector<std::uint8_t> nested(encoded.begin() + block_header::SIZE,
+                                     encoded.end());
+    nested[sizeof(std::uint32_t)] = LZ77_BLOCK;
+    REQUIRE_FALSE(lz77_decode(nested.data(), nested.size(), decoded.data(),
+                              decoded.size()));
+    std::vector<std::uint8_t> huge(encoded.begin() + block_header::SIZE,
+                                   encoded.end());
+    std::memset(huge.data() + sizeof(std::uint32_t) + 1, 0xff,
+                sizeof(std::uint32_t));
+    REQUIRE_FALSE(lz77_decode(huge.data(), huge.size(), decoded.data(),
+                              decoded.size()));
+  }
+}
+
+TEST_CASE("Library", "[library]") {
+  huffman_options options;
+  options.block_size = 4096;
+  options.threads = 2;
+  tira_compressor compressor(options);
+  tira_decompressor decompressor(2);
+
+  SECTION("round trip with one compressor") {
+    std::vector<std::vector<std::uint8_t>> inputs = {
+        {}, text(1), text(4096), text(50000), noise(10000),
+        std::vector<std::uint8_t>(9000, 'y')};
+    for (const std::vector<std::uint8_t> &data : inputs) {
+      std::vector<std::uint8_t> compressed(
+          tira_compress_bound(data.size(), options));
+      std::size_t written = 0;
+      REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                  compressed.size(), written) == TIRA_OK);
+      REQUIRE(written <= compressed.size());
+
+      std::uint64_t size = 0;
+      REQUIRE(tira_decompressed_size(compressed.data(), written, size) ==
+              TIRA_OK);
+      REQUIRE(size == data.size());
+      std::vector<std::uint8_t> decompressed(size);
+      std::size_t decompressed_size = 0;
+      REQUIRE(decompressor.decompress(compressed.data(), written,
+                                      decompressed.data(), decompressed.size(),
+                                      decompressed_size) == TIRA_OK);
+      REQUIRE(decompressed_size == data.size());
+      REQUIRE(decompressed == data);
+    }
+  }
+
+  SECTION("buffers too small") {
+    std::vector<std::uint8_t> data = text(20000);
+    std::vector<std::uint8_t> compressed(tira_compress_bound(data.size()));
+    std::size_t written = 0;
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                10, written) == TIRA_DST_TOO_SMALL);
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                100, written) == TIRA_DST_TOO_SMALL);
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                compressed.size(), written) == TIRA_OK);
+
+    std::vector<std::uint8_t> decompressed(data.size());
+    std::size_t size = 0;
+    REQUIRE(decompressor.decompress(compressed.data(), written,
+                                    decompressed.data(), data.size() - 1,
+                                    size) == TIRA_DST_TOO_SMALL);
+  }
+
+  SECTION("corrupt and unsupported data") {
+    std::vector<std::uint8_t> data = text(20000);
+    std::vector<std::uint8_t> compressed(tira_compress_bound(data.size()));
+    std::size_t written = 0;
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                compressed.size(), written) == TIRA_OK);
+    std::vector<std::uint8_t> decompressed(data.size());
+    std::size_t size = 0;
+    REQUIRE(decompressor.decompress(compressed.data(), written / 2,
+                                    decompressed.data(), decompressed.size(),
+                                    size) == TIRA_CORRUPT);
+    REQUIRE(decompressor.decompress(data.data(), data.size(),
+                                    decompressed.data(), decompressed.size(),
+                                    size) == TIRA_UNSUPPORTED);
+    compressed[4] = CONTAINER_VERSION + 1;
+    REQUIRE(decompressor.decompress(compressed.data(), written,
+                                    decompressed.data(), decompressed.size(),
+                                    size) == TIRA_UNSUPPORTED);
+    REQUIRE(std::string(tira_status_string(TIRA_CORRUPT)) == "corrupt data");
+  }
+
+  SECTION("streamed container") {
+    std::vector<std::uint8_t> data = text(10000);
+    container_header header;
+    header.flags = CONTAINER_STREAMED;
+    header.block_size = 4096;
+    std::vector<std::uint8_t> compressed;
+    write_container_header(header, compressed);
+    for (std::size_t start = 0; start < data.size(); start += 4096) {
+      REQUIRE(encode_block(data.data() + start,
+                           std::min<std::size_t>(4096, data.size() - start),
+                           options, compressed));
+    }
+    write_end_block(compressed);
+
+    std::uint64_t size = 0;
+    REQUIRE(tira_decompressed_size(compressed.data(), compressed.size(),
+                                   size) == TIRA_OK);
+    REQUIRE(size == UNKNOWN_SIZE);
+    std::vector<std::uint8_t> decompressed(data.size());
+    std::size_t written = 0;
+    REQUIRE(decompressor.decompress(compressed.data(), compressed.size(),
+                                    decompressed.data(), decompressed.size(),
+                                    written) == TIRA_OK);
+    REQUIRE(written == data.size());
+    REQUIRE(decompressed == data);
+    REQUIRE(decompressor.decompress(compressed.data(), compressed.size() - 1,
+                                    decompressed.data(), decompressed.size(),
+                                    written) == TIRA_CORRUPT);
+  }
+}
+
+TEST_CASE("Streaming", "[library]") {
+  huffman_options options;
+  options.block_size = 4096;
+  std::vector<std::uint8_t> compressed, decompressed;
+  tira_stream_encoder encoder(
+      [&](const std::uint8_t *data, std::size_t size) {
+        compressed.insert(compressed.end(), data, data + size);
+      },
+      options);
+  tira_stream_decoder decoder(
+      [&](const std::uint8_t *data, std::size_t size) {
+        decompressed.insert(decompressed.end(), data, data + size);
+      });
+  std::vector<std::uint8_t> data = text(30000);
+  data.insert(data.end(), 5000, 'y');
+  std::vector<std::uint8_t> random = noise(5000);
+  data.insert(data.end(), random.begin(), random.end());
+  std::mt19937 rng(5);
+
+  /* feeds `bytes` to the decoder in random pieces of up to `max` bytes */
+  auto feed = [&](const std::vector<std::uint8_t> &bytes, std::size_t max) {
+    for (std::size_t start = 0; start < bytes.size();) {
+      const std::size_t size =
+          std::min<std::size_t>(bytes.size() - start, 1 + rng() % max);
+      REQUIRE(decoder.write(bytes.data() + start, size) == TIRA_OK);
+      start += size;
+    }
+  };
+
+  SECTION("pieces of any size") {
+    for (std::size_t start = 0; start < data.size();) {
+      const std::size_t size =
+          std::min<std::size_t>(data.size() - start, rng() % 10000);
+      REQUIRE(encoder.write(data.data() + start, size) == TIRA_OK);
+      start += size;
+    }
+    REQUIRE(encoder.finish() == TIRA_OK);
+    REQUIRE(encoder.write(data.data(), 1) == TIRA_FINISHED);
+
+    for (std::size_t max : {1, 7, 5000}) {
+      decompressed.clear();
+      decoder.reset();
+      feed(compressed, max);
+      REQUIRE(decoder.done());
+      REQUIRE(decoder.finish() == TIRA_OK);
+      REQUIRE(decompressed == data);
+    }
+
+    /* the one shot decompressor reads it as well */
+    std::vector<std::uint8_t> out(data.size());
+    std::size_t written = 0;
+    tira_decompressor one_shot(1);
+    REQUIRE(one_shot.decompress(compressed.data(), compressed.size(),
+                                out.data(), out.size(), written) == TIRA_OK);
+    REQUIRE(out == data);
+  }
+
+  SECTION("flush makes everything so far decodable") {
+    const std::size_t message = 1000;
+    for (std::size_t start = 0; start < 10 * message; start += message) {
+      const std::size_t before = compressed.size();
+      REQUIRE(encoder.write(data.data() + start, message) == TIRA_OK);
+      REQUIRE(encoder.flush() == TIRA_OK);
+      feed(std::vector<std::uint8_t>(compressed.begin() + before,
+                                     compressed.end()),
+           100);
+      REQUIRE(decompressed.size() == start + message);
+    }
+    REQUIRE(decoder.finish() == TIRA_CORRUPT);
+    REQUIRE(encoder.finish() == TIRA_OK);
+    REQUIRE(decoder.write(compressed.data() + compressed.size() -
+                              block_header::SIZE,
+                          block_header::SIZE) == TIRA_OK);
+    REQUIRE(decoder.finish() == TIRA_OK);
+    REQUIRE(std::equal(decompressed.begin(), decompressed.end(), data.begin()));
+  }
+
+  SECTION("indexed containers and corrupt data") {
+    tira_compressor compressor(options);
+    std::vector<std::uint8_t> indexed(tira_compress_bound(data.size(), options));
+    std::size_t written = 0;
+    REQUIRE(compressor.compress(data.data(), data.size(), indexed.data(),
+                                indexed.size(), written) == TIRA_OK);
+    indexed.resize(written);
+    feed(indexed, 3000);
+    REQUIRE(decoder.finish() == TIRA_OK);
+    REQUIRE(decompressed == data);
+    /* nothing can follow the end */
+    REQUIRE(decoder.write(indexed.data(), 1) == TIRA_CORRUPT);
+
+    decoder.reset();
+    REQUIRE(decoder.write(data.data(), 100) == TIRA_UNSUPPORTED);
+    decoder.reset();
+    /* the raw size of the first block, after the index */
+    container_header header;
+    REQUIRE(read_container_header(indexed.data(), indexed.size(), header));
+    indexed[container_header::SIZE +
+            header.block_count * sizeof(std::uint64_t) + 1] ^= 0xff;
+    REQUIRE(decoder.write(indexed.data(), indexed.size()) == TIRA_CORRUPT);
+    REQUIRE(decoder.finish() == TIRA_CORRUPT);
+  }
+}
+
+TEST_CASE("Stats", "[stats]") {
+  huffman_options options;
+  options.block_size = 4096;
+  options.threads = 2;
+  tira_compressor compressor(options);
+  tira_decompressor decompressor(2);
+  const std::vector<std::uint8_t> data = text(10000);
+  std::vector<std::uint8_t> compressed(tira_compress_bound(data.size(), options));
+  std::vector<std::uint8_t> decompressed(data.size());
+  std::size_t written = 0, decompressed_size = 0;
+  tira_reset_stats();
+
+  SECTION("disabled stats stay at zero") {
+    tira_enable_stats(false);
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                compressed.size(), written) == TIRA_OK);
+    const tira_stats stats = tira_get_stats();
+    for (std::uint64_t counter : stats.counters) {
+      REQUIRE(counter == 0);
+    }
+    for (std::uint64_t nanoseconds : stats.nanoseconds) {
+      REQUIRE(nanoseconds == 0);
+    }
+  }
+
+  SECTION("counters of a round trip") {
+    tira_enable_stats(true);
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                compressed.size(), written) == TIRA_OK);
+    tira_stats stats = tira_get_stats();
+    REQUIRE(stats.counters[STAT_BYTES_IN] == data.size());
+    REQUIRE(stats.counters[STAT_BYTES_OUT] == written);
+    REQUIRE(stats.counters[STAT_BLOCKS] == 3);
+    REQUIRE(stats.counters[STAT_TREES] == 3);
+    REQUIRE(stats.counters[STAT_SYMBOLS] == data.size());
+    REQUIRE(stats.counters[STAT_TREE_HEIGHT] > 0);
+    REQUIRE(stats.counters[STAT_TREE_HEIGHT] <= options.max_code_len);
+
+    tira_reset_stats();
+    REQUIRE(decompressor.decompress(compressed.data(), written,
+                                    decompressed.data(), decompressed.size(),
+                                    decompressed_size) == TIRA_OK);
+    REQUIRE(decompressed == data);
+    stats = tira_get_stats();
+    tira_enable_stats(false);
+    REQUIRE(stats.counters[STAT_BYTES_IN] == written);
+    REQUIRE(stats.counters[STAT_BYTES_OUT] == data.size());
+    REQUIRE(stats.counters[STAT_BLOCKS] == 3);
+    REQUIRE(stats.counters[STAT_SYMBOLS] == data.size());
+  }
+
+  SECTION("summary and json") {
+    tira_enable_stats(true);
+    REQUIRE(compressor.compress(data.data(), data.size(), compressed.data(),
+                                compressed.size(), written) == TIRA_OK);
+    const tira_stats stats = tira_get_stats();
+    tira_enable_stats(false);
+    const std::string json = stats.json();
+    REQUIRE(json.front() == '{');
+    REQUIRE(json.back() == '}');
+    for (const char *key : {"\"timers_ns\"", "\"counters\"", "\"encode\"",
+                            "\"decode\"", "\"bytes_in\"", "\"tree_height\""}) {
+      REQUIRE(json.find(key) != std::string::npos);
+    }
+    REQUIRE(json.find("\"bytes_in\": " + std::to_string(data.size())) !=
+            std::string::npos);
+    REQUIRE(stats.summary().find("histogram") != std::string::npos);
+  }
+}
+
+TEST_CASE("Parallel for", "[parallel]") {
+  SECTION("nested calls visit every index") {
+    std::vector<std::atomic<int>> visits(16 * 16);
+    parallel_for(16, 4, [&](std::size_t i) {
+      parallel_for(16, 4, [&](std::size_t j) { visits[i * 16 + j]++; });
+    });
+    for (const std::atomic<int> &count : visits) {
+      REQUIRE(count == 1);
+    }
+  }
+
+  SECTION("nested calls don't run on more than the threads") {
+    std::atomic<unsigned> active{0}, most{0};
+    parallel_for(4, 4, [&](std::size_t) {
+      parallel_for(8, 4, [&](std::size_t) {
+        const unsigned now = ++active;
+        unsigned seen = most;
+        while (now > seen && !most.compare_exchange_weak(seen, now)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        active--;
+      });
+    });
+    REQUIRE(most <= 4);
+  }
+
+  SECTION("the threads an outer call doesn't use are shared") {
+    std::vector<unsigned> shares(3);
+    parallel_for(1, 4, [&](std::size_t) { shares[0] = parallel_share; });
+    parallel_for(2, 4, [&](std::size_t i) {
+      if (i == 0) {
+        shares[1] = parallel_share;
+      }
+    });
+    parallel_for(8, 4, [&](std::size_t i) {
+      if (i == 0) {
+        shares[2] = parallel_share;
+      }
+    });
+    REQUIRE(shares == std::vector<unsigned>{4, 2, 1});
+    REQUIRE(parallel_share == 0);
+  }
+}
+
+TEST_CASE("Containers in files", "[io]") {
+  const std::string input_name = "tira_container_input";
+  const std::string output_name = "tira_container_output";
+  std::vector<std::uint8_t> data = text(20000);
+  {
+    FILE *input = fopen(input_name.c_str(), "wb");
+    REQUIRE(input != nullptr);
+    fwrite(data.data(), 1, data.size(), input);
+    fclose(input);
+  }
+  huffman_options options;
+  options.block_size = 4096;
+  const std::string prefix = "XXXX";
+
+  /* compresses after the prefix and decodes what comes after it */
+  auto round_trip = [&](const char *mode, std::uint64_t size) {
+    FILE *output = fopen(output_name.c_str(), "wb");
+    REQUIRE(output != nullptr);
+    fwrite(prefix.data(), 1, prefix.size(), output);
+    if (std::string(mode) != "wb") {
+      fclose(output);
+      output = fopen(output_name.c_str(), mode);
+      REQUIRE(output != nullptr);
+    }
+    FILE *input = fopen(input_name.c_str(), "rb");
+    REQUIRE(input != nullptr);
+    REQUIRE(huffman_compress_stream(input, output, size, options));
+    fclose(input);
+    fclose(output);
+
+    mapped_file written;
+    REQUIRE(written.open_read(output_name));
+    REQUIRE(std::equal(prefix.begin(), prefix.end(), written.data()));
+    const std::uint8_t *container = written.data() + prefix.size();
+    const std::size_t container_size = written.size() - prefix.size();
+    container_header header;
+    REQUIRE(read_container_header(container, container_size, header));
+
+    std::vector<std::uint8_t> decompressed(data.size());
+    std::size_t decompressed_size = 0;
+    REQUIRE(tira_decompressor(1).decompress(
+                container, container_size, decompressed.data(),
+                decompressed.size(), decompressed_size) == TIRA_OK);
+    REQUIRE(decompressed == data);
+    return header;
+  };
+
+  SECTION("indexed after other data") {
+    REQUIRE(round_trip("wb", data.size()).flags == CONTAINER_INDEXED);
+  }
+
+  SECTION("appending can't seek back to the index") {
+    REQUIRE(round_trip("ab", data.size()).flags == CONTAINER_STREAMED);
+  }
+
+  SECTION("more blocks than the index has room for") {
+    /* only the size is that large, the blocks end with the input */
+    options.block_size = 1;
+    REQUIRE(round_trip("wb", (std::uint64_t)UINT32_MAX + 1).flags ==
+            CONTAINER_STREAMED);
+  }
+  std::remove(input_name.c_str());
+  std::remove(output_name.c_str());
+}
+
+TEST_CASE("Mapped file", "[io]") {
+  const std::string filename = "tira_mapped_test";
+  std::vector<std::uint8_t> data = noise(10000);
+
+  SECTION("write and read back") {
+    {
+      mapped_file output;
+      REQUIRE(output.open_write(filename, data.size()));
+      REQUIRE(output.size() == data.size());
+      std::copy(data.begin(), data.end(), output.data());
+    }
+    mapped_file input;
+    REQUIRE(input.open_read(filename));
+    REQUIRE(input.size() == data.size());
+    REQUIRE(std::equal(data.begin(), data.end(), input.data()));
+  }
+
+  SECTION("empty file") {
+    {
+      mapped_file output;
+      REQUIRE(output.open_write(filename, 0));
+    }
+    mapped_file input;
+    REQUIRE(input.open_read(filename));
+    REQUIRE(input.size() == 0);
+  }
+
+  SECTION("not a regular file") {
+    mapped_file input;
+    REQUIRE_FALSE(input.open_read("."));
+    REQUIRE_FALSE(input.open_read("tira_file_that_does_not_exist"));
+    /* a fifo without a writer would block if it were opened */
+    REQUIRE(mkfifo(filename.c_str(), 0644) == 0);
+    REQUIRE_FALSE(input.open_read(filename));
+  }
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,440 @@
+#include "../headers/tira.h"
+#include "../headers/block.h"
+#include "../headers/bytes.h"
+#include "../headers/parallel.h"
+#include <atomic>
+#include <cstring>
+
+const char *tira_status_string(tira_status_t status) {
+  switch (status) {
+  case TIRA_OK:
+    return "ok";
+  case TIRA_DST_TOO_SMALL:
+    return "output buffer too small";
+  case TIRA_CORRUPT:
+    return "corrupt data";
+  case TIRA_UNSUPPORTED:
+    return "unsupported format";
+  case TIRA_INVALID_OPTIONS:
+    return "invalid options";
+  case TIRA_ENCODE_FAILED:
+    return "could not compress a block";
+  case TIRA_FINISHED:
+    return "stream already finished";
+  }
+  return "unknown status";
+}
+
+void tira_enable_stats(bool enabled) { enable_stats(enabled); }
+
+void tira_reset_stats() { reset_stats(); }
+
+tira_stats tira_get_stats() { return get_stats(); }
+
+/**
+ * @brief the block size the library uses for the options
+ */
+static std::size_t library_block_size(const huffman_options &options) {
+  return options.block_size ? options.block_size
+                            : huffman_options{}.block_size;
+}
+
+std::size_t tira_compress_bound(std::size_t size,
+                                const huffman_options &options) {
+  const std::size_t block_size = library_block_size(options);
+  const std::size_t blocks = (size + block_size - 1) / block_size;
+  /* a block that doesn't get smaller is stored */
+  return container_header::SIZE +
+         blocks * (sizeof(std::uint64_t) + block_header::SIZE) + size;
+}
+
+tira_status_t tira_decompressed_size(const std::uint8_t *src,
+                                     std::size_t src_size,
+                                     std::uint64_t &size) {
+  container_header header;
+  if (!is_container(src, src_size)) {
+    return TIRA_UNSUPPORTED;
+  }
+  if (!read_container_header(src, src_size, header)) {
+    return src_size < container_header::SIZE ? TIRA_CORRUPT
+                                             : TIRA_UNSUPPORTED;
+  }
+  size = header.flags & CONTAINER_INDEXED ? header.original_size
+                                          : UNKNOWN_SIZE;
+  return TIRA_OK;
+}
+
+tira_compressor::tira_compressor(const huffman_options &options) {
+  set_options(options);
+}
+
+void tira_compressor::set_options(const huffman_options &options) {
+  this->options = options;
+  this->options.block_size = library_block_size(options);
+  encoded.resize(thread_count(options.threads));
+}
+
+tira_status_t tira_compressor::compress(const std::uint8_t *src,
+                                        std::size_t src_size,
+                                        std::uint8_t *dst,
+                                        std::size_t dst_capacity,
+                                        std::size_t &written) {
+  if (options.block_size > UINT32_MAX) {
+    return TIRA_INVALID_OPTIONS;
+  }
+  container_header header;
+  header.flags = CONTAINER_INDEXED;
+  header.block_size = options.block_size;
+  header.original_size = src_size;
+  const std::size_t block_count =
+      (src_size + options.block_size - 1) / options.block_size;
+  if (block_count > UINT32_MAX) {
+    return TIRA_INVALID_OPTIONS;
+  }
+  header.block_count = block_count;
+
+  std::vector<std::uint8_t> &head = encoded[0];
+  head.clear();
+  write_container_header(header, head);
+  const std::size_t index_size = block_count * sizeof(std::uint64_t);
+  if (dst_capacity < head.size() + index_size) {
+    return TIRA_DST_TOO_SMALL;
+  }
+  std::memcpy(dst, head.data(), head.size());
+  std::uint8_t *index = dst + head.size();
+  std::size_t offset = head.size() + index_size;
+
+  /* a batch has a block for every buffer, they're copied out in order */
+  for (std::size_t first = 0; first < block_count; first += encoded.size()) {
+    const std::size_t batch =
+        std::min(encoded.size(), block_count - first);
+    std::atomic<bool> failed{false};
+    parallel_for(batch, encoded.size(), [&](std::size_t i) {
+      const std::size_t start = (first + i) * options.block_size;
+      const std::size_t size =
+          std::min(options.block_size, src_size - start);
+      encoded[i].clear();
+      if (!encode_block(src + start, size, options, encoded[i])) {
+        failed = true;
+      }
+    });
+    if (failed) {
+      return TIRA_ENCODE_FAILED;
+    }
+    for (std::size_t i = 0; i < batch; i++) {
+      if (dst_capacity - offset < encoded[i].size()) {
+        return TIRA_DST_TOO_SMALL;
+      }
+      const std::uint64_t block_offset = offset;
+      std::memcpy(index + (first + i) * sizeof(block_offset), &block_offset,
+                  sizeof(block_offset));
+      std::memcpy(dst + offset, encoded[i].data(), encoded[i].size());
+      offset += encoded[i].size();
+    }
+  }
+  written = offset;
+  stat_add(STAT_BYTES_IN, src_size);
+  stat_add(STAT_BYTES_OUT, written);
+  return TIRA_OK;
+}
+
+tira_status_t tira_decompressor::decompress(const std::uint8_t *src,
+                                            std::size_t src_size,
+                                            std::uint8_t *dst,
+                                            std::size_t dst_capacity,
+                                            std::size_t &written) {
+  std::uint64_t original_size = 0;
+  const tira_status_t status =
+      tira_decompressed_size(src, src_size, original_size);
+  if (status != TIRA_OK) {
+    return status;
+  }
+  container_header header;
+  read_container_header(src, src_size, header);
+
+  if (!(header.flags & CONTAINER_INDEXED)) {
+    /* streamed, the blocks follow each other until the end block */
+    std::size_t position = container_header::SIZE, total = 0;
+    block_header block;
+    while (true) {
+      if (!read_block_header(src + position, src_size - position, block)) {
+        return TIRA_CORRUPT;
+      }
+      position += block_header::SIZE;
+      if (block.method == END_BLOCK) {
+        break;
+      }
+      if (block.raw_size > dst_capacity - total) {
+        return TIRA_DST_TOO_SMALL;
+      }
+      if (!decode_block(block, src + position, dst + total,
+                        thread_count(threads))) {
+        return TIRA_CORRUPT;
+      }
+      position += block.payload_size;
+      total += block.raw_size;
+    }
+    written = total;
+    stat_add(STAT_BYTES_IN, position);
+    stat_add(STAT_BYTES_OUT, written);
+    return TIRA_OK;
+  }
+
+  if (header.block_size == 0 ||
+      (header.original_size + header.block_size - 1) / header.block_size !=
+          header.block_count ||
+      (src_size - container_header::SIZE) / sizeof(std::uint64_t) <
+          header.block_count) {
+    return TIRA_CORRUPT;
+  }
+  if (header.original_size > dst_capacity) {
+    return TIRA_DST_TOO_SMALL;
+  }
+  const std::uint8_t *index = src + container_header::SIZE;
+  /* with fewer blocks than threads the blocks are split at their sync points */
+  const unsigned total_threads = thread_count(threads);
+  const unsigned block_threads = std::max<std::size_t>(
+      1, total_threads / std::max(header.block_count, 1u));
+  std::atomic<bool> failed{false};
+  parallel_for(header.block_count, total_threads, [&](std::size_t i) {
+    const std::uint64_t offset =
+        read_value<std::uint64_t>(index + i * sizeof(offset));
+    const std::uint64_t start = i * (std::uint64_t)header.block_size;
+    block_header block;
+    if (offset > src_size ||
+        !read_block_header(src + offset, src_size - offset, block) ||
+        block.raw_size != std::min<std::uint64_t>(header.block_size,
+                                                  header.original_size -
+                                                      start) ||
+        !decode_block(block, src + offset + block_header::SIZE, dst + start,
+                      block_threads)) {
+      failed = true;
+    }
+  });
+  if (failed) {
+    return TIRA_CORRUPT;
+  }
+  written = header.original_size;
+  stat_add(STAT_BYTES_IN, src_size);
+  stat_add(STAT_BYTES_OUT, written);
+  return TIRA_OK;
+}
+
+tira_stream_encoder::tira_stream_encoder(tira_sink sink,
+                                         const huffman_options &options)
+    : options(options), sink(std::move(sink)) {
+  this->options.block_size = library_block_size(options);
+}
+
+tira_status_t tira_stream_encoder::encode(const std::uint8_t *data,
+                                          std::size_t size) {
+  encoded.clear();
+  if (!started) {
+    container_header header;
+    header.flags = CONTAINER_STREAMED;
+    header.block_size = options.block_size;
+    write_container_header(header, encoded);
+    started = true;
+  }
+  if (size != 0 && !encode_block(data, size, options, encoded)) {
+    return TIRA_ENCODE_FAILED;
+  }
+  if (!encoded.empty()) {
+    stat_add(STAT_BYTES_OUT, encoded.size());
+    sink(encoded.data(), encoded.size());
+  }
+  return TIRA_OK;
+}
+
+tira_status_t tira_stream_encoder::write(const std::uint8_t *data,
+                                         std::size_t size) {
+  if (finished) {
+    return TIRA_FINISHED;
+  }
+  if (options.block_size > UINT32_MAX) {
+    return TIRA_INVALID_OPTIONS;
+  }
+  stat_add(STAT_BYTES_IN, size);
+  const std::size_t block_size = options.block_size;
+  while (size > 0) {
+    /* whole blocks are compressed straight from the caller's data */
+    if (pending.empty() && size >= block_size) {
+      const tira_status_t status = encode(data, block_size);
+      if (status != TIRA_OK) {
+        return status;
+      }
+      data += block_size;
+      size -= block_size;
+      continue;
+    }
+    const std::size_t take = std::min(size, block_size - pending.size());
+    pending.insert(pending.end(), data, data + take);
+    data += take;
+    size -= take;
+    if (pending.size() == block_size) {
+      const tira_status_t status = encode(pending.data(), pending.size());
+      pending.clear();
+      if (status != TIRA_OK) {
+        return status;
+      }
+    }
+  }
+  return TIRA_OK;
+}
+
+tira_status_t tira_stream_encoder::flush() {
+  if (finished) {
+    return TIRA_FINISHED;
+  }
+  const tira_status_t status = encode(pending.data(), pending.size());
+  pending.clear();
+  return status;
+}
+
+tira_status_t tira_stream_encoder::finish() {
+  const tira_status_t status = flush();
+  if (status != TIRA_OK) {
+    return status;
+  }
+  encoded.clear();
+  write_end_block(encoded);
+  stat_add(STAT_BYTES_OUT, encoded.size());
+  sink(encoded.data(), encoded.size());
+  finished = true;
+  return TIRA_OK;
+}
+
+void tira_stream_encoder::reset() {
+  pending.clear();
+  started = false;
+  finished = false;
+}
+
+tira_status_t tira_stream_decoder::decode() {
+  std::size_t position = 0;
+  while (status == TIRA_OK) {
+    const std::size_t left = pending.size() - position;
+    if (!started) {
+      if (left < container_header::SIZE) {
+        break;
+      }
+      const std::uint8_t *head = pending.data() + position;
+      if (!is_container(head, left) ||
+          !read_container_header(head, left, header)) {
+        status = TIRA_UNSUPPORTED;
+        break;
+      }
+      if (header.block_size == 0 ||
+          !(header.flags & (CONTAINER_INDEXED | CONTAINER_STREAMED)) ||
+          ((header.flags & CONTAINER_INDEXED) &&
+           (header.original_size + header.block_size - 1) /
+                   header.block_size !=
+               header.block_count)) {
+        status = TIRA_CORRUPT;
+        break;
+      }
+      /* the blocks of an indexed container are in order too */
+      if (header.flags & CONTAINER_INDEXED) {
+        index_left = header.block_count * sizeof(std::uint64_t);
+      }
+      position += container_header::SIZE;
+      started = true;
+      continue;
+    }
+    if (index_left != 0) {
+      const std::size_t skip = std::min<std::uint64_t>(left, index_left);
+      position += skip;
+      index_left -= skip;
+      if (index_left != 0) {
+        break;
+      }
+      continue;
+    }
+    if (finished) {
+      /* anything after the end isn't part of the container */
+      if (left != 0) {
+        status = TIRA_CORRUPT;
+      }
+      break;
+    }
+
+    const bool streamed = header.flags & CONTAINER_STREAMED;
+    if (!streamed && blocks == header.block_count) {
+      finished = true;
+      continue;
+    }
+    if (left < block_header::SIZE) {
+      break;
+    }
+    block_header block;
+    const std::uint8_t *raw = pending.data() + position;
+    /* anything larger than this can't be a valid block */
+    if (!read_block_header(raw,
+                           block_header::SIZE +
+                               max_payload_size(header.block_size),
+                           block)) {
+      status = TIRA_CORRUPT;
+      break;
+    }
+    if (block.method == END_BLOCK) {
+      if (!streamed || block.payload_size != 0) {
+        status = TIRA_CORRUPT;
+        break;
+      }
+      position += block_header::SIZE;
+      finished = true;
+      continue;
+    }
+    const std::uint64_t expected = std::min<std::uint64_t>(
+        header.block_size,
+        header.original_size - (std::uint64_t)blocks * header.block_size);
+    if (block.raw_size > header.block_size ||
+        (!streamed && block.raw_size != expected)) {
+      status = TIRA_CORRUPT;
+      break;
+    }
+    if (left - block_header::SIZE < block.payload_size) {
+      break;
+    }
+    decoded.resize(block.raw_size);
+    if (!decode_block(block, raw + block_header::SIZE, decoded.data())) {
+      status = TIRA_CORRUPT;
+      break;
+    }
+    if (!decoded.empty()) {
+      stat_add(STAT_BYTES_OUT, decoded.size());
+      sink(decoded.data(), decoded.size());
+    }
+    position += block_header::SIZE + block.payload_size;
+    blocks++;
+  }
+  pending.erase(pending.begin(), pending.begin() + position);
+  return status;
+}
+
+tira_status_t tira_stream_decoder::write(const std::uint8_t *data,
+                                         std::size_t size) {
+  if (status != TIRA_OK) {
+    return status;
+  }
+  stat_add(STAT_BYTES_IN, size);
+  pending.insert(pending.end(), data, data + size);
+  return decode();
+}
+
+tira_status_t tira_stream_decoder::finish() {
+  if (status != TIRA_OK) {
+    return status;
+  }
+  return finished ? TIRA_OK : TIRA_CORRUPT;
+}
+
+void tira_stream_decoder::reset() {
+  header = {};
+  pending.clear();
+  index_left = 0;
+  blocks = 0;
+  started = false;
+  finished = false;
+  status = TIRA_OK;
+}